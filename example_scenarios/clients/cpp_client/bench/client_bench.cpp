@@ -0,0 +1,193 @@
+// Throughput benchmark of the client's protocol loop against a mock
+// HyperMapper. The same binary is the driver, which runs the client library
+// with a trivial objective, and the mock server, which the client launches
+// in place of HyperMapper: it sends Request batches of the configured sizes,
+// waits for each reply and reports per batch size
+// - configurations per second,
+// - bytes per second, requests and replies together,
+// - p50 and p99 latency of a batch, from the first byte of the request to
+//   the last byte of the reply, i.e. the parse -> eval -> reply pipeline.
+//
+// Usage: client_bench [--batch-sizes 1,100,10000] [--params N]
+//                     [--digits N] [--batches N] [--threads N]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../cpp_client.h"
+#include "../hm_protocol.h"
+#include "../hypermapper_client.h"
+
+using namespace std;
+
+struct BenchOptions {
+  vector<size_t> BatchSizes = {1, 10, 100, 1000, 10000};
+  int NumParams = 10;
+  // Significant digits of every value, sets the line width
+  int Digits = 17;
+  int NumBatches = 20;
+  int NumThreads = 1;
+};
+
+static void usage(const char *Name) {
+  cerr << "Usage: " << Name << " [--batch-sizes 1,100,10000] [--params N]"
+       << " [--digits N] [--batches N] [--threads N]" << endl;
+  exit(EXIT_FAILURE);
+}
+
+// Parses the options in argv[First, argc), the mock server ignores the
+// trailing scenario file
+static BenchOptions parseOptions(int argc, char **argv, int First) {
+  BenchOptions Options;
+  for (int i = First; i < argc; i++) {
+    string Arg = argv[i];
+    if (i + 1 == argc) {
+      if (Arg.find(".json") != string::npos)
+        break;
+      usage(argv[0]);
+    }
+    string Value = argv[++i];
+    if (Arg == "--batch-sizes") {
+      Options.BatchSizes.clear();
+      stringstream Sizes(Value);
+      string Size;
+      while (getline(Sizes, Size, ','))
+        Options.BatchSizes.push_back(stoul(Size));
+    } else if (Arg == "--params") {
+      Options.NumParams = stoi(Value);
+    } else if (Arg == "--digits") {
+      Options.Digits = stoi(Value);
+    } else if (Arg == "--batches") {
+      Options.NumBatches = stoi(Value);
+    } else if (Arg == "--threads") {
+      Options.NumThreads = stoi(Value);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (Options.BatchSizes.empty() || Options.NumParams < 1 ||
+      Options.Digits < 1 || Options.NumBatches < 1)
+    usage(argv[0]);
+  return Options;
+}
+
+static string joinOptions(const BenchOptions &Options) {
+  string Sizes;
+  for (size_t Size : Options.BatchSizes)
+    Sizes += (Sizes.empty() ? "" : ",") + to_string(Size);
+  return " --batch-sizes " + Sizes + " --params " +
+         to_string(Options.NumParams) + " --digits " +
+         to_string(Options.Digits) + " --batches " +
+         to_string(Options.NumBatches);
+}
+
+// Mock HyperMapper: talks to the client on stdin/stdout, reports on stderr
+static int runServer(const BenchOptions &Options) {
+  mt19937_64 Rand(0);
+  uniform_real_distribution<double> Dist(0, 1);
+  HMLineReader Reader(0);
+  vector<string_view> ReplyLines;
+  string Header;
+  for (int param = 0; param < Options.NumParams; param++)
+    Header += (param ? ",x" : "x") + to_string(param);
+  Header += "\n";
+
+  fprintf(stderr, "%10s %7s %12s %14s %12s %10s %10s\n", "batch", "params",
+          "bytes/req", "configs/s", "MB/s", "p50 ms", "p99 ms");
+  char Field[64];
+  for (size_t BatchSize : Options.BatchSizes) {
+    string Request = "Request " + to_string(BatchSize) + "\n" + Header;
+    for (size_t config = 0; config < BatchSize; config++)
+      for (int param = 0; param < Options.NumParams; param++) {
+        snprintf(Field, sizeof(Field), "%.*g", Options.Digits, Dist(Rand));
+        Request += Field;
+        Request += param + 1 < Options.NumParams ? ',' : '\n';
+      }
+
+    // One untimed batch to warm up the client's buffers
+    vector<double> Latencies;
+    size_t ReplyBytes = 0;
+    double TotalSeconds = 0;
+    for (int batch = 0; batch <= Options.NumBatches; batch++) {
+      auto Start = chrono::steady_clock::now();
+      writeAll(1, Request);
+      if (!Reader.readLines(BatchSize + 1, ReplyLines)) {
+        fprintf(stderr, "The client closed the connection\n");
+        return EXIT_FAILURE;
+      }
+      auto End = chrono::steady_clock::now();
+      if (batch == 0)
+        continue;
+      double Seconds = chrono::duration<double>(End - Start).count();
+      Latencies.push_back(Seconds * 1e3);
+      TotalSeconds += Seconds;
+      for (string_view Line : ReplyLines)
+        ReplyBytes += Line.size();
+    }
+    sort(Latencies.begin(), Latencies.end());
+    size_t N = Latencies.size();
+    double P50 = Latencies[N / 2];
+    double P99 = Latencies[min(N - 1, size_t(ceil(0.99 * N)) - 1)];
+    double Bytes = double(Request.size()) * N + ReplyBytes;
+    fprintf(stderr, "%10zu %7d %12zu %14.0f %12.1f %10.3f %10.3f\n",
+            BatchSize, Options.NumParams, Request.size(),
+            BatchSize * N / TotalSeconds, Bytes / TotalSeconds / 1e6, P50,
+            P99);
+  }
+  writeAll(1, "End of HyperMapper\n");
+  return 0;
+}
+
+// Objective that costs next to nothing, so the client is what is measured
+static void benchObjective(const HMConfig &Config, HMObjective &Obj) {
+  Obj[0] = Config[0];
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && !strcmp(argv[1], "--server"))
+    return runServer(parseOptions(argc, argv, 2));
+
+  BenchOptions Options = parseOptions(argc, argv, 1);
+  char Self[4096];
+  ssize_t SelfSize = readlink("/proc/self/exe", Self, sizeof(Self) - 1);
+  if (SelfSize < 0) {
+    cerr << "Unable to locate the benchmark binary" << endl;
+    return EXIT_FAILURE;
+  }
+  Self[SelfSize] = '\0';
+
+  HMScenario Scenario;
+  Scenario.AppName = "client_bench";
+  Scenario.OutputFoldername = "bench_outdata";
+  Scenario.Predictor = false;
+  Scenario.NumCPUs = Options.NumThreads;
+  Scenario.Objectives = {"value"};
+  Scenario.ComputePareto = false;
+  Scenario.LogLevel = HMLogOff;
+  Scenario.ServerCommand = string(Self) + " --server" + joinOptions(Options);
+  vector<HMInputParam> Params;
+  Params.reserve(Options.NumParams);
+  for (int param = 0; param < Options.NumParams; param++) {
+    Params.emplace_back("x" + to_string(param), ParamType::Real);
+    Params.back().setRange({0, 1});
+    Scenario.InParams.push_back(&Params.back());
+  }
+
+  HyperMapperClient Client;
+  try {
+    Client.run(Scenario, benchObjective);
+  } catch (const HMError &E) {
+    cerr << "FATAL: " << E.what() << endl;
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
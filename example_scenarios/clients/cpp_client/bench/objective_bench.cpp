@@ -0,0 +1,91 @@
+// Microbenchmark of the Chakong and Haimes objective. Evaluates the same
+// generated batch through the per-configuration calculateObjective, the
+// portable batch kernel and the vectorized one, checks that they agree and
+// reports points per second and the time per batch for each.
+//
+// Usage: objective_bench [NumPoints]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../chakong_haimes.h"
+#include "../hypermapper_client.h"
+
+using namespace std;
+
+static void evaluatePerConfig(const HMScenario &Scenario, const HMBatch &Batch,
+                              HMResults &Results) {
+  for (size_t Row = 0; Row < Batch.size(); Row++) {
+    HMObjective Obj(Results, Row);
+    calculateObjective(HMConfig(Scenario.InParams, Batch, Row), Obj);
+  }
+}
+
+template <typename EvaluateFn>
+static void measure(const char *Name, EvaluateFn Evaluate,
+                    const HMBatch &Batch, const HMResults &Reference) {
+  const int Repetitions = 5;
+  HMResults Results;
+  double Best = HUGE_VAL;
+  for (int r = 0; r < Repetitions; r++) {
+    Results.reset(Batch.size(), 2, 0);
+    auto Start = chrono::steady_clock::now();
+    Evaluate(Results);
+    chrono::duration<double> Elapsed = chrono::steady_clock::now() - Start;
+    Best = min(Best, Elapsed.count());
+  }
+  size_t N = Batch.size();
+  size_t Bytes = N * sizeof(double);
+  bool Same = !memcmp(Results.objective(0), Reference.objective(0), Bytes) &&
+              !memcmp(Results.objective(1), Reference.objective(1), Bytes) &&
+              !memcmp(Results.feasible(), Reference.feasible(), N);
+  cout << Name << ": " << static_cast<long>(N / Best) << " points/s, "
+       << Best * 1e6 << " us per batch" << (Same ? "" : " (MISMATCH)")
+       << "\n";
+  if (!Same)
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  size_t NumPoints = argc > 1 ? atol(argv[1]) : 100000;
+
+  HMScenario Scenario;
+  createScenario(Scenario);
+  mt19937 Gen(0);
+  uniform_int_distribution<int> Dist(-20, 20);
+  HMBatch Batch;
+  Batch.resize(NumPoints, Scenario.InParams.size());
+  for (size_t param = 0; param < Batch.getNumParams(); param++)
+    for (size_t Row = 0; Row < NumPoints; Row++)
+      Batch.at(Row, param) = Dist(Gen);
+
+  HMResults Reference;
+  Reference.reset(NumPoints, 2, 0);
+  evaluatePerConfig(Scenario, Batch, Reference);
+
+  cout << NumPoints << " points\n";
+  measure(
+      "calculateObjective per configuration",
+      [&](HMResults &Results) { evaluatePerConfig(Scenario, Batch, Results); },
+      Batch, Reference);
+  measure(
+      "calculateObjectivesScalar",
+      [&](HMResults &Results) {
+        HMBatchSlice Slice(Batch, Results, 0, NumPoints);
+        calculateObjectivesScalar(Slice);
+      },
+      Batch, Reference);
+  string Name = string("calculateObjectives (") + getObjectivesKernel() + ")";
+  measure(
+      Name.c_str(),
+      [&](HMResults &Results) {
+        HMBatchSlice Slice(Batch, Results, 0, NumPoints);
+        calculateObjectives(Slice);
+      },
+      Batch, Reference);
+  return 0;
+}
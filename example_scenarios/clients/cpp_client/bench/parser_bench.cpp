@@ -0,0 +1,129 @@
+// Microbenchmark for reading and parsing the value lines of a HyperMapper
+// request. The generated batch is written to a pipe by another thread, as
+// HyperMapper writes it to the client, and read back both with the original
+// fgets/std::string/substr/stoi parser and with HMLineReader and the
+// in-place HMLineTokenizer parser. Reports rows per second for both.
+//
+// Usage: parser_bench [NumRows] [NumParams]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../hm_protocol.h"
+
+using namespace std;
+
+// Original parser: every line is read with fgets, copied into a std::string
+// and every field is cut out with substr and converted with stoi.
+static long parseLegacy(int FD, int NumRows, int NumParams,
+                        vector<int> &Values) {
+  const int max_buffer = 1000;
+  char buffer[max_buffer];
+  FILE *In = fdopen(FD, "r");
+  long Sum = 0;
+  for (int row = 0; row < NumRows; row++) {
+    if (!fgets(buffer, max_buffer, In)) {
+      cerr << "Input ended early\n";
+      exit(EXIT_FAILURE);
+    }
+    string bufferStr(buffer);
+    size_t pos = 0;
+    for (int param = 0; param < NumParams; param++) {
+      size_t len = bufferStr.find_first_of(",\n", pos) - pos;
+      string ParamValStr = bufferStr.substr(pos, len);
+      Values[param] = stoi(ParamValStr);
+      pos = bufferStr.find_first_of(",\n", pos) + 1;
+    }
+    Sum += Values[0];
+  }
+  fclose(In);
+  return Sum;
+}
+
+// In-place parser: the batch is read into HMLineReader's buffer, fields are
+// views into it and are converted with std::from_chars.
+static long parseInPlace(int FD, int NumRows, int NumParams,
+                         vector<int> &Values) {
+  HMLineReader Reader(FD);
+  vector<string_view> Lines;
+  if (!Reader.readLines(NumRows, Lines)) {
+    cerr << "Input ended early\n";
+    exit(EXIT_FAILURE);
+  }
+  long Sum = 0;
+  for (string_view Raw : Lines) {
+    HMLineTokenizer Tokenizer(Raw);
+    string_view Field;
+    for (int param = 0; param < NumParams; param++) {
+      if (!Tokenizer.next(Field) || !parseField(Field, Values[param])) {
+        cerr << "Parse error\n";
+        exit(EXIT_FAILURE);
+      }
+    }
+    Sum += Values[0];
+  }
+  close(FD);
+  return Sum;
+}
+
+template <typename ParseFn>
+static void measure(const char *Name, ParseFn Parse, const string &Text,
+                    int NumRows, int NumParams) {
+  vector<int> Values(NumParams);
+  const int Repetitions = 5;
+  double Best = 0;
+  long Check = 0;
+  for (int r = 0; r < Repetitions; r++) {
+    int Pipe[2];
+    if (pipe(Pipe)) {
+      cerr << "Unable to create pipe\n";
+      exit(EXIT_FAILURE);
+    }
+    auto Start = chrono::steady_clock::now();
+    thread Writer([&] {
+      for (size_t Pos = 0; Pos < Text.size();) {
+        ssize_t Written = write(Pipe[1], Text.data() + Pos, Text.size() - Pos);
+        if (Written <= 0)
+          break;
+        Pos += Written;
+      }
+      close(Pipe[1]);
+    });
+    Check += Parse(Pipe[0], NumRows, NumParams, Values);
+    chrono::duration<double> Elapsed = chrono::steady_clock::now() - Start;
+    Writer.join();
+    double RowsPerSec = NumRows / Elapsed.count();
+    if (RowsPerSec > Best)
+      Best = RowsPerSec;
+  }
+  cout << Name << ": " << static_cast<long>(Best) << " rows/s"
+       << " (checksum " << Check << ")\n";
+}
+
+int main(int argc, char **argv) {
+  int NumRows = argc > 1 ? atoi(argv[1]) : 100000;
+  int NumParams = argc > 2 ? atoi(argv[2]) : 20;
+
+  // Keep lines under the 1000 byte limit of the legacy parser
+  mt19937 Gen(0);
+  uniform_int_distribution<int> Dist(-20, 20);
+  string Text;
+  for (int row = 0; row < NumRows; row++) {
+    for (int param = 0; param < NumParams; param++) {
+      Text += to_string(Dist(Gen));
+      Text += param + 1 < NumParams ? ',' : '\n';
+    }
+  }
+
+  cout << NumRows << " rows, " << NumParams << " parameters\n";
+  measure("fgets substr/stoi (before)", parseLegacy, Text, NumRows, NumParams);
+  measure("HMLineReader from_chars (after)", parseInPlace, Text, NumRows,
+          NumParams);
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HM_OBJECTIVES_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HM_OBJECTIVES_NEON 1
+#endif
+
+#include "chakong_haimes.h"
+#include "cpp_client.h"
+#include "hm_space.h"
+
+using namespace std;
+
+// Input parameters of the problem
+static constexpr auto ChakongHaimesSpace =
+    makeSpace(makeInteger("x0", -20, 20), makeInteger("x1", -20, 20));
+
+// Function that takes input parameter values and stores the objectives
+// It is called concurrently from the evaluator threads, so it must not
+// modify shared state.
+void calculateObjective(const HMConfig &Config, HMObjective &Obj) {
+
+  auto [x1, x2] = ChakongHaimesSpace.decode(Config);
+
+  Obj[0] = 2 + (x1 - 2) * (x1 - 2) + (x2 - 1) * (x2 - 1);
+  Obj[1] = 9 * x1 - (x2 - 1) * (x2 - 1);
+
+  bool c1 = ((x1 * x1 + x2 * x2) <= 255);
+  bool c2 = ((x1 - 3 * x2 + 10) <= 0);
+  Obj.setFeasible(c1 && c2);
+}
+
+// Rounds half away from zero like HMConfig::getInt, without the libm call
+// of round()
+static inline double roundScalar(double V) {
+  return double(long(V + copysign(0.5, V)));
+}
+
+// The batch versions compute on doubles, which hold the products of
+// parameters in [-20, 20] exactly
+static inline void evaluatePoint(double V1, double V2, double &F1, double &F2,
+                                 uint8_t &Feasible) {
+  double x1 = roundScalar(V1);
+  double x2 = roundScalar(V2);
+  F1 = 2 + (x1 - 2) * (x1 - 2) + (x2 - 1) * (x2 - 1);
+  F2 = 9 * x1 - (x2 - 1) * (x2 - 1);
+  Feasible = (x1 * x1 + x2 * x2 <= 255) & (x1 - 3 * x2 + 10 <= 0);
+}
+
+void calculateObjectivesScalar(HMBatchSlice &Slice) {
+  const double *X1 = Slice.param(0), *X2 = Slice.param(1);
+  double *F1 = Slice.objective(0), *F2 = Slice.objective(1);
+  uint8_t *Feasible = Slice.feasible();
+  for (size_t i = 0; i < Slice.size(); i++)
+    evaluatePoint(X1[i], X2[i], F1[i], F2[i], Feasible[i]);
+}
+
+#ifdef HM_OBJECTIVES_AVX2
+// Same rounding as roundScalar, _mm256_round_pd alone rounds half to even
+__attribute__((target("avx2"))) static inline __m256d roundAVX2(__m256d V) {
+  __m256d Half = _mm256_or_pd(_mm256_and_pd(V, _mm256_set1_pd(-0.0)),
+                              _mm256_set1_pd(0.5));
+  return _mm256_round_pd(_mm256_add_pd(V, Half),
+                         _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+// Four configurations per iteration
+__attribute__((target("avx2"))) static void
+calculateObjectivesAVX2(HMBatchSlice &Slice) {
+  const double *X1 = Slice.param(0), *X2 = Slice.param(1);
+  double *F1 = Slice.objective(0), *F2 = Slice.objective(1);
+  uint8_t *Feasible = Slice.feasible();
+  const __m256d One = _mm256_set1_pd(1), Two = _mm256_set1_pd(2),
+                Three = _mm256_set1_pd(3), Nine = _mm256_set1_pd(9),
+                Ten = _mm256_set1_pd(10), Limit = _mm256_set1_pd(255),
+                Zero = _mm256_setzero_pd();
+  size_t N = Slice.size(), i = 0;
+  for (; i + 4 <= N; i += 4) {
+    __m256d x1 = roundAVX2(_mm256_loadu_pd(X1 + i));
+    __m256d x2 = roundAVX2(_mm256_loadu_pd(X2 + i));
+    __m256d A = _mm256_sub_pd(x1, Two);
+    __m256d B = _mm256_sub_pd(x2, One);
+    __m256d AA = _mm256_mul_pd(A, A);
+    __m256d BB = _mm256_mul_pd(B, B);
+    _mm256_storeu_pd(F1 + i, _mm256_add_pd(Two, _mm256_add_pd(AA, BB)));
+    _mm256_storeu_pd(F2 + i, _mm256_sub_pd(_mm256_mul_pd(Nine, x1), BB));
+    __m256d C1 = _mm256_cmp_pd(
+        _mm256_add_pd(_mm256_mul_pd(x1, x1), _mm256_mul_pd(x2, x2)), Limit,
+        _CMP_LE_OQ);
+    __m256d C2 = _mm256_cmp_pd(
+        _mm256_add_pd(_mm256_sub_pd(x1, _mm256_mul_pd(Three, x2)), Ten), Zero,
+        _CMP_LE_OQ);
+    int Mask = _mm256_movemask_pd(_mm256_and_pd(C1, C2));
+    for (int lane = 0; lane < 4; lane++)
+      Feasible[i + lane] = (Mask >> lane) & 1;
+  }
+  for (; i < N; i++)
+    evaluatePoint(X1[i], X2[i], F1[i], F2[i], Feasible[i]);
+}
+#endif
+
+#ifdef HM_OBJECTIVES_NEON
+// Two configurations per iteration
+static void calculateObjectivesNEON(HMBatchSlice &Slice) {
+  const double *X1 = Slice.param(0), *X2 = Slice.param(1);
+  double *F1 = Slice.objective(0), *F2 = Slice.objective(1);
+  uint8_t *Feasible = Slice.feasible();
+  const float64x2_t One = vdupq_n_f64(1), Two = vdupq_n_f64(2),
+                    Three = vdupq_n_f64(3), Nine = vdupq_n_f64(9),
+                    Ten = vdupq_n_f64(10), Limit = vdupq_n_f64(255),
+                    Zero = vdupq_n_f64(0);
+  size_t N = Slice.size(), i = 0;
+  for (; i + 2 <= N; i += 2) {
+    // vrndaq rounds half away from zero like roundScalar
+    float64x2_t x1 = vrndaq_f64(vld1q_f64(X1 + i));
+    float64x2_t x2 = vrndaq_f64(vld1q_f64(X2 + i));
+    float64x2_t A = vsubq_f64(x1, Two);
+    float64x2_t B = vsubq_f64(x2, One);
+    float64x2_t BB = vmulq_f64(B, B);
+    vst1q_f64(F1 + i, vaddq_f64(Two, vaddq_f64(vmulq_f64(A, A), BB)));
+    vst1q_f64(F2 + i, vsubq_f64(vmulq_f64(Nine, x1), BB));
+    uint64x2_t C1 =
+        vcleq_f64(vaddq_f64(vmulq_f64(x1, x1), vmulq_f64(x2, x2)), Limit);
+    uint64x2_t C2 =
+        vcleq_f64(vaddq_f64(vsubq_f64(x1, vmulq_f64(Three, x2)), Ten), Zero);
+    uint64x2_t C = vandq_u64(C1, C2);
+    Feasible[i] = vgetq_lane_u64(C, 0) & 1;
+    Feasible[i + 1] = vgetq_lane_u64(C, 1) & 1;
+  }
+  for (; i < N; i++)
+    evaluatePoint(X1[i], X2[i], F1[i], F2[i], Feasible[i]);
+}
+#endif
+
+namespace {
+struct ObjectivesKernel {
+  void (*Fn)(HMBatchSlice &);
+  const char *Name;
+};
+} // namespace
+
+// Picks the widest kernel the processor runs, once
+static const ObjectivesKernel &getKernel() {
+  static const ObjectivesKernel Kernel = []() -> ObjectivesKernel {
+#ifdef HM_OBJECTIVES_AVX2
+    if (__builtin_cpu_supports("avx2"))
+      return {calculateObjectivesAVX2, "avx2"};
+#endif
+#ifdef HM_OBJECTIVES_NEON
+    return {calculateObjectivesNEON, "neon"};
+#endif
+    return {calculateObjectivesScalar, "scalar"};
+  }();
+  return Kernel;
+}
+
+void calculateObjectives(HMBatchSlice &Slice) { getKernel().Fn(Slice); }
+
+const char *getObjectivesKernel() { return getKernel().Name; }
+
+void createScenario(HMScenario &Scenario) {
+  // Set these values accordingly
+  // TODO: make these command line inputs
+  Scenario.OutputFoldername = "outdata";
+  Scenario.AppName = "cpp_chakong_haimes";
+  Scenario.NumIterations = 20;
+  Scenario.NumSamples = 10;
+  Scenario.Predictor = 1;
+  Scenario.NumCPUs = 0;
+  Scenario.Objectives = {"f1_value", "f2_value"};
+
+  ChakongHaimesSpace.describe(Scenario);
+}
@@ -0,0 +1,23 @@
+#ifndef CHAKONG_HAIMES_H
+#define CHAKONG_HAIMES_H
+#include "hypermapper_client.h"
+
+// The Chakong and Haimes example problem, shared by the client and hm_agent
+// so that both describe the same scenario.
+
+// Function that takes input parameter values and stores the objectives
+void calculateObjective(const HMConfig &Config, HMObjective &Obj);
+
+// Function that evaluates a slice of configurations at once, with AVX2 or
+// NEON when the processor has them. Same results as calculateObjective
+// for the integer parameters of createScenario.
+void calculateObjectives(HMBatchSlice &Slice);
+// Portable version of calculateObjectives
+void calculateObjectivesScalar(HMBatchSlice &Slice);
+// Instruction set calculateObjectives uses: "avx2", "neon" or "scalar"
+const char *getObjectivesKernel();
+
+// Function that populates the scenario and its input parameters
+void createScenario(HMScenario &Scenario);
+
+#endif
@@ -1,17 +1,31 @@
 #ifndef HPVM_HYPERMAPPER_H
 #define HPVM_HYPERMAPPER_H
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <initializer_list>
 #include <iomanip>
+#include <sstream>
+#include <stdexcept>
 #include <vector>
 
 class HMInputParam;
-void fatalError(const std::string &msg);
+
+// Error raised by the HyperMapper client library
+class HMError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// Reports an unrecoverable error by throwing HMError
+[[noreturn]] void fatalError(const std::string &msg);
 
 // Enum for HyperMapper parameter types
 enum ParamType { Real, Integer, Ordinal, Categorical };
 
-std::ostream &operator<<(std::ostream &out, const ParamType &PT) {
+inline std::ostream &operator<<(std::ostream &out, const ParamType &PT) {
   switch (PT) {
   case Real:
     out << "Real";
@@ -29,7 +43,7 @@ std::ostream &operator<<(std::ostream &out, const ParamType &PT) {
   return out;
 }
 
-std::string getTypeAsString(const ParamType &PT) {
+inline std::string getTypeAsString(const ParamType &PT) {
   std::string TypeString;
   switch (PT) {
   case Real:
@@ -49,20 +63,28 @@ std::string getTypeAsString(const ParamType &PT) {
   return TypeString;
 }
 
+// Key of the parameter at position Position of a scenario, used for it in
+// the scenario file and the messages exchanged with HyperMapper. Keys only
+// depend on the position, so every copy of a scenario and every study
+// running at once agree on them.
+inline std::string getParamKey(size_t Position) {
+  return "x" + std::to_string(Position);
+}
+
 // HyperMapper Input Parameter object
 class HMInputParam {
 private:
   std::string Name;
-  std::string const Key;
   ParamType Type;
-  std::vector<int> Range;
-  static int count;
-  int Value;
+  // Real and Integer: {min, max}. Ordinal: the allowed values. Categorical:
+  // the numeric value of each category, empty for string categories.
+  std::vector<double> Range;
+  // Categorical: the category names, as sent by HyperMapper
+  std::vector<std::string> Categories;
 
 public:
   HMInputParam(std::string _Name = "", ParamType _Type = ParamType::Integer)
-      : Name(_Name), Type(_Type),
-        Key("x" + std::to_string(count++)) {}
+      : Name(_Name), Type(_Type) {}
 
   std::string getName() const { return Name; }
   void setName(std::string _Name) { Name = _Name; }
@@ -70,60 +92,78 @@ public:
   ParamType getType() const { return Type; }
   void setType(ParamType _Type) { Type = _Type; }
 
-  void setRange(std::vector<int> const &_Range) { Range = _Range; }
-  std::vector<int> getRange() const { return Range; }
-
-  std::string getKey() const { return Key; }
-
-  int getVal() const {return Value;}
-  void setVal(int _Value) {Value = _Value;}
-
-  bool operator==(const std::string &_Key) {
-    if (Key == _Key) {
-      return true;
-    } else {
-      return false;
-    }
+  // Sets the range, or for a categorical parameter its numeric categories
+  void setRange(std::vector<double> const &_Range) {
+    Range = _Range;
+    Categories.clear();
+    if (Type == ParamType::Categorical)
+      for (double V : Range)
+        Categories.push_back(formatValue(V));
   }
+  void setRange(std::vector<int> const &_Range) {
+    setRange(std::vector<double>(_Range.begin(), _Range.end()));
+  }
+  void setRange(std::initializer_list<double> _Range) {
+    setRange(std::vector<double>(_Range));
+  }
+  const std::vector<double> &getRange() const { return Range; }
 
-  bool operator==(const HMInputParam &IP) {
-    if (Key == IP.getKey()) {
-      return true;
-    } else {
-      return false;
-    }
+  // Sets string categories of a categorical parameter
+  void setCategories(std::vector<std::string> const &_Categories) {
+    Range.clear();
+    Categories = _Categories;
+  }
+  const std::vector<std::string> &getCategories() const { return Categories; }
+
+  // Whether the categories of a categorical parameter are numbers
+  bool hasNumericCategories() const { return !Range.empty(); }
+
+  // V as Python's repr writes it, which is how HyperMapper echoes numeric
+  // categories: the shortest digits that read back as V, fixed notation
+  // from 1e-4 up to 1e16 with ".0" on integral values. Integral values
+  // below 1e15 have no fractional part, as the scenario file writes them.
+  static std::string formatValue(double V) {
+    char Buffer[32];
+    std::to_chars_result Result;
+    double Magnitude = std::fabs(V);
+    bool Integral = V == std::nearbyint(V);
+    if (Integral && Magnitude < 1e15)
+      return std::string(
+          Buffer,
+          std::to_chars(Buffer, Buffer + sizeof(Buffer), int64_t(V)).ptr);
+    if (Magnitude < 1e-4 || Magnitude >= 1e16)
+      Result = std::to_chars(Buffer, Buffer + sizeof(Buffer), V,
+                             std::chars_format::scientific);
+    else
+      Result = std::to_chars(Buffer, Buffer + sizeof(Buffer), V,
+                             std::chars_format::fixed);
+    std::string Text(Buffer, Result.ptr);
+    if (Integral && Magnitude < 1e16)
+      Text += ".0";
+    return Text;
   }
+
   friend std::ostream &operator<<(std::ostream &out, const HMInputParam &IP) {
-    out << IP.getKey() << ":";
-    out << "\n  Name: " << IP.Name;
+    out << IP.Name << ":";
     out << "\n  Type: " << IP.Type;
-    if (IP.getType() == ParamType::Ordinal ||
-        IP.getType() == ParamType::Categorical) {
-      out << "\n  Range: {";
-      char separator[1] = "";
-      for (auto i : IP.getRange()) {
-        out << separator << i;
-        separator[0] = ',';
+    bool IsSet = IP.getType() == ParamType::Ordinal ||
+                 IP.getType() == ParamType::Categorical;
+    out << "\n  Range: " << (IsSet ? "{" : "[");
+    const char *separator = "";
+    if (IP.getType() == ParamType::Categorical) {
+      for (auto &C : IP.getCategories()) {
+        out << separator << C;
+        separator = ",";
       }
-      out << "}";
-    } else if (IP.getType() == ParamType::Integer) {
-      out << "\n  Range: [";
-      char separator[1] = "";
+    } else {
       for (auto i : IP.getRange()) {
-        out << separator << i;
-        separator[0] = ',';
+        out << separator << formatValue(i);
+        separator = ",";
       }
-      out << "]";
     }
+    out << (IsSet ? "}" : "]");
     return out;
   }
 };
 
-// HyperMapper Objective object
-struct HMObjective {
-  int f1_value;
-  int f2_value;
-  bool valid;
-};
-
 #endif
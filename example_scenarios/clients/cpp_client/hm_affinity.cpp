@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <tuple>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "cpp_client.h"
+#include "hm_affinity.h"
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+const char *getPlacementName(HMPlacement Placement) {
+  switch (Placement) {
+  case HMPlaceAny:
+    return "any";
+  case HMPlaceCore:
+    return "core";
+  case HMPlaceNode:
+    return "node";
+  }
+  return "unknown";
+}
+
+HMPlacement parsePlacement(const string &Name) {
+  for (HMPlacement P : {HMPlaceAny, HMPlaceCore, HMPlaceNode})
+    if (Name == getPlacementName(P))
+      return P;
+  fatalError("Unknown placement " + Name + ", use any, core or node");
+}
+
+// CPUs the calling thread may run on
+static HMCPUSet getThreadCPUs() {
+  HMCPUSet CPUs;
+#ifdef __linux__
+  cpu_set_t Set;
+  CPU_ZERO(&Set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(Set), &Set) == 0)
+    for (int CPU = 0; CPU < CPU_SETSIZE; CPU++)
+      if (CPU_ISSET(CPU, &Set))
+        CPUs.push_back(CPU);
+#endif
+  return CPUs;
+}
+
+bool pinThread(const HMCPUSet &CPUs) {
+  if (CPUs.empty())
+    return true;
+#ifdef __linux__
+  cpu_set_t Set;
+  CPU_ZERO(&Set);
+  for (int CPU : CPUs)
+    CPU_SET(CPU, &Set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(Set), &Set) == 0;
+#else
+  return false;
+#endif
+}
+
+HMThreadPinning::HMThreadPinning(const HMCPUSet &CPUs) {
+  if (CPUs.empty())
+    return;
+  Previous = getThreadCPUs();
+  pinThread(CPUs);
+}
+
+HMThreadPinning::~HMThreadPinning() { pinThread(Previous); }
+
+// First integer in the file at Path, Default if it cannot be read
+static int readSysInt(const string &Path, int Default) {
+  ifstream In(Path);
+  int Value;
+  return In >> Value ? Value : Default;
+}
+
+// NUMA node of CPU, from the node<N> entry of its sysfs directory
+static int getCPUNode(int CPU) {
+  error_code EC;
+  string Dir = "/sys/devices/system/cpu/cpu" + to_string(CPU);
+  for (fs::directory_iterator It(Dir, EC), End; !EC && It != End;
+       It.increment(EC)) {
+    string Name = It->path().filename();
+    if (Name.size() > 4 && Name.compare(0, 4, "node") == 0 &&
+        all_of(Name.begin() + 4, Name.end(), ::isdigit))
+      return stoi(Name.substr(4));
+  }
+  return 0;
+}
+
+// A physical core and the node it is on
+struct HMCore {
+  int Node;
+  HMCPUSet CPUs;
+};
+
+// Physical cores with CPUs this process may use, ordered by node. Without
+// topology information every CPU counts as a core of node 0.
+static vector<HMCore> getPhysicalCores() {
+  map<tuple<int, int, int>, HMCore> Cores;
+  for (int CPU : getThreadCPUs()) {
+    string Topology =
+        "/sys/devices/system/cpu/cpu" + to_string(CPU) + "/topology/";
+    int Node = getCPUNode(CPU);
+    int Package = readSysInt(Topology + "physical_package_id", 0);
+    int Core = readSysInt(Topology + "core_id", CPU);
+    HMCore &C = Cores[{Node, Package, Core}];
+    C.Node = Node;
+    C.CPUs.push_back(CPU);
+  }
+  vector<HMCore> Result;
+  for (auto &Entry : Cores)
+    Result.push_back(Entry.second);
+  return Result;
+}
+
+HMPlacementPlan planPlacement(HMPlacement Placement, unsigned NumWorkers) {
+  HMPlacementPlan Plan;
+  vector<HMCore> Cores;
+  if (Placement != HMPlaceAny)
+    Cores = getPhysicalCores();
+  if (Cores.empty()) {
+    if (NumWorkers == 0)
+      NumWorkers = max(1u, thread::hardware_concurrency());
+    Plan.Workers.resize(NumWorkers);
+    return Plan;
+  }
+  if (Cores.size() > 1) {
+    Plan.Protocol = Cores.front().CPUs;
+    Cores.erase(Cores.begin());
+  }
+  if (NumWorkers == 0)
+    NumWorkers = Cores.size();
+  if (Placement == HMPlaceCore) {
+    // One CPU per core, so the SMT siblings stay idle
+    for (unsigned w = 0; w < NumWorkers; w++)
+      Plan.Workers.push_back({Cores[w % Cores.size()].CPUs.front()});
+    return Plan;
+  }
+  vector<HMCPUSet> Nodes;
+  int LastNode = -1;
+  for (const HMCore &C : Cores) {
+    if (Nodes.empty() || C.Node != LastNode)
+      Nodes.emplace_back();
+    LastNode = C.Node;
+    Nodes.back().insert(Nodes.back().end(), C.CPUs.begin(), C.CPUs.end());
+  }
+  for (auto &Node : Nodes)
+    sort(Node.begin(), Node.end());
+  for (unsigned w = 0; w < NumWorkers; w++)
+    Plan.Workers.push_back(Nodes[w % Nodes.size()]);
+  return Plan;
+}
+
+string formatCPUSet(const HMCPUSet &CPUs) {
+  if (CPUs.empty())
+    return "any";
+  string Out;
+  for (size_t i = 0; i < CPUs.size();) {
+    size_t j = i;
+    while (j + 1 < CPUs.size() && CPUs[j + 1] == CPUs[j] + 1)
+      j++;
+    Out += (Out.empty() ? "" : ",") + to_string(CPUs[i]);
+    if (j > i)
+      Out += "-" + to_string(CPUs[j]);
+    i = j + 1;
+  }
+  return Out;
+}
@@ -0,0 +1,66 @@
+#ifndef HM_AFFINITY_H
+#define HM_AFFINITY_H
+#include <string>
+#include <vector>
+
+// Placement of the evaluation workers on the CPUs of the machine, for
+// objectives that time code on the same host. Workers that migrate between
+// cores, share the SMT siblings of a core or another NUMA node's memory make
+// the measurements noisy.
+
+// Where the evaluation workers run
+enum HMPlacement {
+  // Wherever the operating system schedules them
+  HMPlaceAny,
+  // Each worker on a physical core of its own, the SMT siblings of the core
+  // left idle
+  HMPlaceCore,
+  // Workers spread over the NUMA nodes, each free to move within its node
+  HMPlaceNode,
+};
+
+// Name used in options: any, core or node
+const char *getPlacementName(HMPlacement Placement);
+// Placement with the given name, a fatal error if it is unknown
+HMPlacement parsePlacement(const std::string &Name);
+
+// CPUs a thread may run on, empty for all of them
+using HMCPUSet = std::vector<int>;
+
+// CPUs of the protocol thread and of every worker. Under HMPlaceCore and
+// HMPlaceNode the first physical core is reserved for the protocol thread
+// when there are at least two, so parsing and replies do not disturb the
+// workers. Workers share cores only when there are more workers than
+// cores left.
+struct HMPlacementPlan {
+  HMCPUSet Protocol;
+  std::vector<HMCPUSet> Workers;
+};
+
+// Places NumWorkers workers, 0 for one per core left after the reserved
+// one (or per hardware thread for HMPlaceAny), on the CPUs this process may
+// use
+HMPlacementPlan planPlacement(HMPlacement Placement, unsigned NumWorkers);
+
+// Restricts the calling thread to CPUs. Does nothing for an empty set or
+// where thread affinity is not supported. Returns false if it failed.
+bool pinThread(const HMCPUSet &CPUs);
+
+// Pins the calling thread to CPUs for its lifetime and then restores the
+// CPUs it was allowed to run on before
+class HMThreadPinning {
+public:
+  explicit HMThreadPinning(const HMCPUSet &CPUs);
+  ~HMThreadPinning();
+
+  HMThreadPinning(const HMThreadPinning &) = delete;
+  HMThreadPinning &operator=(const HMThreadPinning &) = delete;
+
+private:
+  HMCPUSet Previous;
+};
+
+// Readable form of CPUs, e.g. "0,2-3"
+std::string formatCPUSet(const HMCPUSet &CPUs);
+
+#endif
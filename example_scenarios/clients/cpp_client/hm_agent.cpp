@@ -0,0 +1,37 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "chakong_haimes.h"
+#include "cpp_client.h"
+#include "hm_remote.h"
+
+using namespace std;
+
+// Evaluation agent for the example scenario. Run it on every machine that
+// should evaluate configurations and pass its address to cpp_client with
+// --agent host:port.
+int main(int argc, char **argv) {
+  int Port = 7070;
+  unsigned Slots = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--port") && i + 1 < argc) {
+      Port = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--slots") && i + 1 < argc) {
+      Slots = atoi(argv[++i]);
+    } else {
+      cerr << "Usage: " << argv[0] << " [--port P] [--slots N]" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  HMScenario Scenario;
+  createScenario(Scenario);
+  try {
+    runAgent(Port, Slots, Scenario, calculateObjective);
+  } catch (const HMError &E) {
+    cerr << "FATAL: " << E.what() << endl;
+    return EXIT_FAILURE;
+  }
+}
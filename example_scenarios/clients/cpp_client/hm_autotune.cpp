@@ -0,0 +1,40 @@
+#include <algorithm>
+#include <cmath>
+
+#include "hm_autotune.h"
+
+using namespace std;
+
+// Largest batch in rounds of the workers
+static constexpr double MaxRounds = 16;
+// Largest share of an iteration left to HyperMapper's turnaround
+static constexpr double MaxTurnaroundShare = 0.1;
+// Batches evaluating in less than this on one thread do not gain from
+// waking the workers
+static constexpr double MinParallelMs = 0.1;
+
+HMAutoTuneChoice chooseBatchSize(const HMRunStats &Pilot) {
+  HMAutoTuneChoice Choice;
+  if (!Pilot.NumRounds || !Pilot.NumTurnarounds)
+    return Choice;
+  double E = Pilot.EvalMs / Pilot.NumRounds;
+  double T = Pilot.TurnaroundMs / Pilot.NumTurnarounds;
+  size_t W = max(1u, Pilot.NumWorkers);
+
+  // Rounds R with T <= MaxTurnaroundShare * (T + R * E)
+  double Rounds = MaxRounds;
+  if (E > 0)
+    Rounds = ceil(T * (1 - MaxTurnaroundShare) / (MaxTurnaroundShare * E));
+  Rounds = min(max(Rounds, 1.0), MaxRounds);
+  size_t Batch = W * size_t(Rounds);
+  if (Batch * E < MinParallelMs)
+    W = 1;
+
+  Choice.EvaluationsPerIteration = Batch;
+  Choice.NumWorkers = W;
+  Choice.EvalMs = E;
+  Choice.TurnaroundMs = T;
+  double IterationMs = T + ((Batch + W - 1) / W) * E;
+  Choice.Throughput = IterationMs > 0 ? Batch * 1e3 / IterationMs : 0;
+  return Choice;
+}
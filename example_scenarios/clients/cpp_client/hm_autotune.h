@@ -0,0 +1,28 @@
+#ifndef HM_AUTOTUNE_H
+#define HM_AUTOTUNE_H
+
+#include "hypermapper_client.h"
+
+// Batch size and worker count picked from the timings of a pilot run.
+//
+// An iteration with a batch of B configurations on W workers takes the
+// HyperMapper turnaround T, from the reply to the next request, plus
+// ceil(B / W) rounds of the evaluation latency E, so it evaluates
+//   B / (T + ceil(B / W) * E)
+// configurations per second. This grows with B towards W / E, while larger
+// batches update HyperMapper's model less often. The batch is the smallest
+// multiple of W whose turnaround takes at most a tenth of the iteration,
+// i.e. 90% of the maximum rate, up to 16 rounds of the workers.
+struct HMAutoTuneChoice {
+  int EvaluationsPerIteration = 1;
+  int NumWorkers = 1;
+  // Measured evaluation latency and HyperMapper turnaround
+  double EvalMs = 0;
+  double TurnaroundMs = 0;
+  // Expected configurations per second, 0 if the pilot measured nothing
+  double Throughput = 0;
+};
+
+HMAutoTuneChoice chooseBatchSize(const HMRunStats &Pilot);
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef HM_BATCH_H
+#define HM_BATCH_H
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Parameter values of one request batch, stored as one contiguous column of
+// doubles per parameter. Real, integer and ordinal parameters store their
+// value, categorical parameters the index of their category, so every type
+// shares the same unboxed representation.
+class HMBatch {
+private:
+  size_t NumConfigs = 0;
+  size_t NumParams = 0;
+  std::vector<double> Values;
+
+public:
+  // Resizes the store for a new batch, keeping the allocated capacity
+  void resize(size_t _NumConfigs, size_t _NumParams) {
+    NumConfigs = _NumConfigs;
+    NumParams = _NumParams;
+    Values.resize(NumConfigs * NumParams);
+  }
+
+  size_t size() const { return NumConfigs; }
+  size_t getNumParams() const { return NumParams; }
+
+  // Column of parameter Param, one value per configuration
+  double *column(size_t Param) { return Values.data() + Param * NumConfigs; }
+  const double *column(size_t Param) const {
+    return Values.data() + Param * NumConfigs;
+  }
+
+  double get(size_t Config, size_t Param) const {
+    return Values[Param * NumConfigs + Config];
+  }
+  double &at(size_t Config, size_t Param) {
+    return Values[Param * NumConfigs + Config];
+  }
+};
+
+// Results of one request batch: one contiguous column of doubles per
+// objective followed by one per extra metric, and a feasibility flag per
+// configuration. The storage is reused from batch to batch.
+class HMResults {
+private:
+  size_t NumConfigs = 0;
+  size_t NumObjectives = 0;
+  size_t NumMetrics = 0;
+  std::vector<double> Values;
+  std::vector<uint8_t> Feasible;
+
+public:
+  // Prepares the store for a new batch. Values start as NaN and every
+  // configuration as feasible.
+  void reset(size_t _NumConfigs, size_t _NumObjectives, size_t _NumMetrics) {
+    NumConfigs = _NumConfigs;
+    NumObjectives = _NumObjectives;
+    NumMetrics = _NumMetrics;
+    Values.assign(NumConfigs * (NumObjectives + NumMetrics),
+                  std::numeric_limits<double>::quiet_NaN());
+    Feasible.assign(NumConfigs, 1);
+  }
+
+  size_t size() const { return NumConfigs; }
+  size_t getNumObjectives() const { return NumObjectives; }
+  size_t getNumMetrics() const { return NumMetrics; }
+
+  // Column of objective Obj, one value per configuration
+  const double *objective(size_t Obj) const {
+    return Values.data() + Obj * NumConfigs;
+  }
+  double *objective(size_t Obj) { return Values.data() + Obj * NumConfigs; }
+  // Column of extra metric Metric
+  const double *metric(size_t Metric) const {
+    return objective(NumObjectives + Metric);
+  }
+  double *metric(size_t Metric) { return objective(NumObjectives + Metric); }
+  const uint8_t *feasible() const { return Feasible.data(); }
+  uint8_t *feasible() { return Feasible.data(); }
+
+  double &at(size_t Config, size_t Column) {
+    return Values[Column * NumConfigs + Config];
+  }
+  uint8_t &feasibleAt(size_t Config) { return Feasible[Config]; }
+};
+
+class HMEarlyStop;
+
+// Writable view of the results of one configuration, filled in place by the
+// objective function
+class HMObjective {
+private:
+  HMResults &Results;
+  size_t Row;
+  HMEarlyStop *EarlyStop;
+
+public:
+  HMObjective(HMResults &_Results, size_t _Row,
+              HMEarlyStop *_EarlyStop = nullptr)
+      : Results(_Results), Row(_Row), EarlyStop(_EarlyStop) {}
+
+  // Number of objectives, in the order of HMScenario::Objectives
+  size_t size() const { return Results.getNumObjectives(); }
+
+  // Value of objective Obj
+  double &operator[](size_t Obj) { return Results.at(Row, Obj); }
+
+  // Value of extra metric Metric, in the order of HMScenario::Metrics
+  double &metric(size_t Metric) {
+    return Results.at(Row, Results.getNumObjectives() + Metric);
+  }
+
+  void setFeasible(bool Feasible) { Results.feasibleAt(Row) = Feasible; }
+  bool isFeasible() const { return Results.feasible()[Row]; }
+
+  // Reports the objectives stored so far as an estimate at Fidelity, the
+  // share of the evaluation's budget done, in (0, 1]. Returns false when
+  // the estimate is confidently dominated and the evaluation should return
+  // with it in place, see HMScenario::EarlyStopping. Always true when early
+  // stopping is off.
+  bool reportInterim(double Fidelity);
+};
+
+// Contiguous columns of the configurations [Begin, End) of a batch and of
+// their results, filled in place by a batch objective
+class HMBatchSlice {
+private:
+  const HMBatch &Batch;
+  HMResults &Results;
+  size_t Begin;
+  size_t End;
+
+public:
+  HMBatchSlice(const HMBatch &_Batch, HMResults &_Results, size_t _Begin,
+               size_t _End)
+      : Batch(_Batch), Results(_Results), Begin(_Begin), End(_End) {}
+
+  size_t size() const { return End - Begin; }
+
+  // Values of parameter Param, in the order of HMScenario::InParams and
+  // stored as in HMBatch
+  const double *param(size_t Param) const {
+    return Batch.column(Param) + Begin;
+  }
+
+  // Values of objective Obj and extra metric Metric, NaN until set
+  double *objective(size_t Obj) { return Results.objective(Obj) + Begin; }
+  double *metric(size_t Metric) { return Results.metric(Metric) + Begin; }
+
+  // Feasibility flags, 1 until set to 0
+  uint8_t *feasible() { return Results.feasible() + Begin; }
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_cache.h"
+
+using namespace std;
+
+static constexpr char CacheMagic[8] = {'H', 'M', 'C', 'A', 'C', 'H', 'E', '1'};
+static constexpr size_t CacheHeaderSize = 32;
+
+// Reads exactly Size bytes at Offset of FD
+static bool readAt(int FD, char *Data, size_t Size, off_t Offset) {
+  while (Size > 0) {
+    ssize_t NumRead = pread(FD, Data, Size, Offset);
+    if (NumRead < 0 && errno == EINTR)
+      continue;
+    if (NumRead <= 0)
+      return false;
+    Data += NumRead;
+    Size -= NumRead;
+    Offset += NumRead;
+  }
+  return true;
+}
+
+void HMEvalCache::open(const string &Path, uint64_t Signature,
+                       size_t _NumParams, size_t _NumOutputs,
+                       HMLogLevel LogLevel) {
+  close();
+  NumParams = _NumParams;
+  NumOutputs = _NumOutputs;
+  Records.clear();
+  Index.clear();
+  Pending.clear();
+  Hits = Misses = 0;
+
+  HMResponseWriter Header;
+  Header.append(string_view(CacheMagic, sizeof(CacheMagic)));
+  Header.appendLE(Signature);
+  Header.appendLE(uint64_t(NumParams));
+  Header.appendLE(uint64_t(NumOutputs));
+
+  FD = ::open(Path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (FD < 0)
+    fatalError("Unable to open file: " + Path);
+  struct stat Stat;
+  if (fstat(FD, &Stat))
+    fatalError("Unable to read file: " + Path);
+
+  string Data(Stat.st_size, '\0');
+  if (!readAt(FD, &Data[0], Data.size(), 0))
+    fatalError("Unable to read file: " + Path);
+  if (!Data.empty() &&
+      Data.compare(0, CacheHeaderSize, Header.data()) != 0) {
+    // Written for another scenario, keep it aside and start over
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluation cache " << Path << " is for another scenario, moving "
+                               << "it to " << Path << ".old" << endl);
+    ::close(FD);
+    FD = -1;
+    if (rename(Path.c_str(), (Path + ".old").c_str()))
+      fatalError("Unable to rename file: " + Path);
+    FD = ::open(Path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (FD < 0)
+      fatalError("Unable to open file: " + Path);
+    Data.clear();
+  }
+  if (Data.empty()) {
+    writeAll(FD, Header.data());
+    Data.assign(Header.data());
+  }
+
+  size_t RecordBytes = recordSize() * sizeof(double);
+  size_t NumRecords = (Data.size() - CacheHeaderSize) / RecordBytes;
+  size_t ValidSize = CacheHeaderSize + NumRecords * RecordBytes;
+  if (ValidSize != Data.size() && ftruncate(FD, ValidSize))
+    fatalError("Unable to truncate file: " + Path);
+  if (lseek(FD, ValidSize, SEEK_SET) < 0)
+    fatalError("Unable to seek in file: " + Path);
+
+  vector<double> Record(recordSize());
+  string_view Body = string_view(Data).substr(CacheHeaderSize);
+  for (size_t r = 0; r < NumRecords; r++) {
+    for (size_t i = 0; i < Record.size(); i++)
+      Record[i] = readLEDouble(Body, (r * Record.size() + i) * sizeof(double));
+    add(Record.data());
+  }
+  HM_LOG(LogLevel, HMLogSummary,
+         "Evaluation cache " << Path << " holds " << size()
+                             << " configurations" << endl);
+}
+
+void HMEvalCache::close() {
+  if (FD < 0)
+    return;
+  flush();
+  ::close(FD);
+  FD = -1;
+}
+
+void HMEvalCache::add(const double *Record) {
+  uint64_t Hash = hashKey(Record);
+  // Later records of the same configuration replace earlier ones
+  auto Range = Index.equal_range(Hash);
+  for (auto It = Range.first; It != Range.second; ++It) {
+    double *Existing = &Records[It->second];
+    if (memcmp(Existing, Record, NumParams * sizeof(double)) == 0) {
+      copy(Record, Record + recordSize(), Existing);
+      return;
+    }
+  }
+  Index.emplace(Hash, Records.size());
+  Records.insert(Records.end(), Record, Record + recordSize());
+}
+
+const double *HMEvalCache::find(const double *Key) const {
+  auto Range = Index.equal_range(hashKey(Key));
+  for (auto It = Range.first; It != Range.second; ++It) {
+    const double *Record = &Records[It->second];
+    if (memcmp(Record, Key, NumParams * sizeof(double)) == 0)
+      return Record + NumParams;
+  }
+  return nullptr;
+}
+
+const double *HMEvalCache::lookup(const double *Key) {
+  const double *Outputs = find(Key);
+  if (Outputs)
+    Hits++;
+  else
+    Misses++;
+  return Outputs;
+}
+
+void HMEvalCache::insert(const double *Key, const double *Outputs,
+                         bool Feasible) {
+  vector<double> Record(Key, Key + NumParams);
+  Record.insert(Record.end(), Outputs, Outputs + NumOutputs);
+  Record.push_back(Feasible ? 1.0 : 0.0);
+  add(Record.data());
+  for (double V : Record)
+    Pending.appendLE(V);
+}
+
+void HMEvalCache::flush() {
+  if (FD < 0 || Pending.data().empty())
+    return;
+  writeAll(FD, Pending.data());
+  Pending.clear();
+}
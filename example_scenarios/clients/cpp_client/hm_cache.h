@@ -0,0 +1,85 @@
+#ifndef HM_CACHE_H
+#define HM_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+#include <vector>
+
+#include "hm_log.h"
+#include "hm_protocol.h"
+
+// 64 bit FNV-1a hash of Size bytes at Data, continuing from Hash
+inline uint64_t hashBytes(const void *Data, size_t Size,
+                          uint64_t Hash = 14695981039346656037ull) {
+  const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+  for (size_t i = 0; i < Size; i++) {
+    Hash ^= Bytes[i];
+    Hash *= 1099511628211ull;
+  }
+  return Hash;
+}
+
+// Content-addressed cache of evaluated configurations. A configuration is
+// the packed vector of its parameter values in HMBatch representation, and
+// maps to its outputs (objectives and extra metrics) and feasibility.
+// Entries are kept in memory and appended to a binary log, so later runs of
+// the same scenario start with every configuration evaluated so far.
+//
+// The log starts with a header holding a magic string, the scenario
+// signature and the record shape, followed by fixed size records of
+// NumParams + NumOutputs + 1 little-endian doubles.
+class HMEvalCache {
+private:
+  size_t NumParams = 0;
+  size_t NumOutputs = 0;
+  std::vector<double> Records;
+  std::unordered_multimap<uint64_t, size_t> Index;
+  // Serialized records not yet appended to the log
+  HMResponseWriter Pending;
+  int FD = -1;
+  size_t Hits = 0;
+  size_t Misses = 0;
+
+  size_t recordSize() const { return NumParams + NumOutputs + 1; }
+  uint64_t hashKey(const double *Key) const {
+    return hashBytes(Key, NumParams * sizeof(double));
+  }
+  void add(const double *Record);
+
+public:
+  HMEvalCache() = default;
+  // Records that were not flushed are lost, flush() may throw
+  ~HMEvalCache() {
+    if (FD >= 0)
+      ::close(FD);
+  }
+  HMEvalCache(const HMEvalCache &) = delete;
+  HMEvalCache &operator=(const HMEvalCache &) = delete;
+
+  // Loads the log at Path and opens it for appending, creating it if
+  // needed. A log written for another Signature is moved to Path.old and a
+  // new one is started. A partial trailing record is dropped.
+  void open(const std::string &Path, uint64_t Signature, size_t NumParams,
+            size_t NumOutputs, HMLogLevel LogLevel);
+  void close();
+
+  // Outputs of the configuration Key, followed by its feasibility (0 or 1),
+  // or nullptr if it was never evaluated. Counts a hit or a miss.
+  const double *lookup(const double *Key);
+  // Same as lookup without counting
+  const double *find(const double *Key) const;
+
+  // Adds the evaluated configuration Key. The log is written by flush().
+  void insert(const double *Key, const double *Outputs, bool Feasible);
+
+  // Appends the records inserted since the last flush to the log
+  void flush();
+
+  size_t size() const { return Index.size(); }
+  size_t getHits() const { return Hits; }
+  size_t getMisses() const { return Misses; }
+};
+
+#endif
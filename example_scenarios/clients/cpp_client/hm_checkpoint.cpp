@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_checkpoint.h"
+
+using namespace std;
+
+void HMCheckpoint::open(const string &_Path, const string &Header,
+                        HMLogLevel LogLevel) {
+  close();
+  Path = _Path;
+  Pending.clear();
+  NumRows = 0;
+  LastTimestamp = 0;
+
+  FD = ::open(Path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (FD < 0)
+    fatalError("Unable to open file: " + Path);
+  struct stat Stat;
+  if (fstat(FD, &Stat))
+    fatalError("Unable to read file: " + Path);
+  HMMappedFile File;
+  if (Stat.st_size > 0)
+    File.open(Path);
+  string_view Data = File.data();
+  string_view Line;
+  nextLine(Data, Line);
+  if (!Line.empty() && stripLineEnd(Line) != Header) {
+    // Written for another scenario, keep it aside and start over
+    HM_LOG(LogLevel, HMLogSummary,
+           "Checkpoint " << Path << " is for another scenario, moving it to "
+                         << Path << ".old" << endl);
+    File.close();
+    ::close(FD);
+    FD = -1;
+    if (rename(Path.c_str(), (Path + ".old").c_str()))
+      fatalError("Unable to rename file: " + Path);
+    FD = ::open(Path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (FD < 0)
+      fatalError("Unable to open file: " + Path);
+    Data = Line = string_view();
+  }
+  if (Line.empty() || Line.back() != '\n') {
+    // New log, or one that died while writing its header
+    if (ftruncate(FD, 0))
+      fatalError("Unable to truncate file: " + Path);
+    writeAll(FD, Header + "\n");
+    if (fdatasync(FD))
+      fatalError("Unable to sync file: " + Path);
+    HM_LOG(LogLevel, HMLogSummary, "Checkpointing to " << Path << endl);
+    return;
+  }
+
+  // Count the complete rows, a row without '\n' was torn by a crash
+  size_t ValidSize = Line.size();
+  while (nextLine(Data, Line) && Line.back() == '\n') {
+    ValidSize += Line.size();
+    NumRows++;
+    Line = stripLineEnd(Line);
+    size_t Comma = Line.rfind(',');
+    parseField(Line.substr(Comma == string_view::npos ? 0 : Comma + 1),
+               LastTimestamp);
+  }
+  File.close();
+  if (ValidSize != size_t(Stat.st_size) && ftruncate(FD, ValidSize))
+    fatalError("Unable to truncate file: " + Path);
+  if (lseek(FD, ValidSize, SEEK_SET) < 0)
+    fatalError("Unable to seek in file: " + Path);
+  HM_LOG(LogLevel, HMLogSummary,
+         "Checkpoint " << Path << " holds " << NumRows << " configurations"
+                       << endl);
+}
+
+void HMCheckpoint::close() {
+  if (FD < 0)
+    return;
+  commit();
+  ::close(FD);
+  FD = -1;
+}
+
+void HMCheckpoint::append(string_view Row, double Timestamp) {
+  Pending.append(Row);
+  Pending.append('\n');
+  NumRows++;
+  LastTimestamp = Timestamp;
+}
+
+void HMCheckpoint::commit() {
+  if (FD < 0 || Pending.data().empty())
+    return;
+  writeAll(FD, Pending.data());
+  Pending.clear();
+  if (fdatasync(FD))
+    fatalError("Unable to sync file: " + Path);
+}
@@ -0,0 +1,58 @@
+#ifndef HM_CHECKPOINT_H
+#define HM_CHECKPOINT_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+#include "hm_log.h"
+#include "hm_protocol.h"
+
+// Durable log of the answered configurations of a study, so a run that dies
+// can be resumed by HyperMapper (resume_optimization) instead of starting
+// over. The log is a csv file in the format HyperMapper reads: a header
+// with the input parameters, the outputs and Timestamp, then one row per
+// evaluated configuration. Rows are appended and synced to disk once per
+// batch.
+class HMCheckpoint {
+private:
+  // Rows not yet written to the log
+  HMResponseWriter Pending;
+  std::string Path;
+  int FD = -1;
+  size_t NumRows = 0;
+  double LastTimestamp = 0;
+
+public:
+  HMCheckpoint() = default;
+  // Rows that were not committed are lost, commit() may throw
+  ~HMCheckpoint() {
+    if (FD >= 0)
+      ::close(FD);
+  }
+  HMCheckpoint(const HMCheckpoint &) = delete;
+  HMCheckpoint &operator=(const HMCheckpoint &) = delete;
+
+  // Opens the log at Path for appending, creating it with Header (without
+  // '\n') if needed. A log with another header is moved to Path.old and a
+  // new one is started. A partial trailing row is dropped.
+  void open(const std::string &Path, const std::string &Header,
+            HMLogLevel LogLevel);
+  void close();
+
+  // Appends a row, given without '\n'. Its last field is its timestamp in
+  // milliseconds. The log is written by commit().
+  void append(std::string_view Row, double Timestamp);
+
+  // Writes the rows appended since the last commit and waits until they
+  // are on disk
+  void commit();
+
+  const std::string &getPath() const { return Path; }
+  // Number of rows in the log, committed or not
+  size_t size() const { return NumRows; }
+  // Timestamp of the last row, 0 if there is none
+  double getLastTimestamp() const { return LastTimestamp; }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <numeric>
+#include <set>
+
+#include "hm_doe.h"
+
+using namespace std;
+
+// SplitMix64, a small generator that gives the same sequence everywhere
+static uint64_t nextRandom(uint64_t &State) {
+  uint64_t Z = (State += 0x9e3779b97f4a7c15);
+  Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9;
+  Z = (Z ^ (Z >> 27)) * 0x94d049bb133111eb;
+  return Z ^ (Z >> 31);
+}
+
+// Uniform double in [0, 1)
+static double nextUniform(uint64_t &State) {
+  return (nextRandom(State) >> 11) * 0x1.0p-53;
+}
+
+// Value of Param at the fraction U in [0, 1) of its range
+static double valueAt(const HMInputParam &Param, double U) {
+  const vector<double> &Range = Param.getRange();
+  // Index of one of NumValues discrete values
+  auto pick = [&](size_t NumValues) {
+    return min(NumValues - 1, size_t(U * NumValues));
+  };
+  switch (Param.getType()) {
+  case Real:
+    return Range[0] + U * (Range[1] - Range[0]);
+  case Integer:
+    return Range[0] + double(pick(size_t(Range[1] - Range[0]) + 1));
+  case Ordinal:
+    return Range[pick(Range.size())];
+  case Categorical:
+    return double(pick(Param.getCategories().size()));
+  }
+  return 0;
+}
+
+size_t generateLatinHypercube(const vector<HMInputParam *> &Params,
+                              size_t NumSamples, uint64_t Seed,
+                              HMBatch &Batch) {
+  size_t NumParams = Params.size();
+  HMBatch Sample;
+  Sample.resize(NumSamples, NumParams);
+  uint64_t State = Seed;
+  vector<size_t> Strata(NumSamples);
+  for (size_t Param = 0; Param < NumParams; Param++) {
+    // Random assignment of the strata to the samples
+    iota(Strata.begin(), Strata.end(), 0);
+    for (size_t I = NumSamples; I > 1; I--)
+      swap(Strata[I - 1], Strata[size_t(nextUniform(State) * I)]);
+    double *Column = Sample.column(Param);
+    for (size_t Row = 0; Row < NumSamples; Row++)
+      Column[Row] = valueAt(*Params[Param],
+                            (Strata[Row] + nextUniform(State)) / NumSamples);
+  }
+
+  // Keep the first occurrence of every configuration
+  set<vector<double>> Seen;
+  vector<size_t> Unique;
+  vector<double> Config(NumParams);
+  for (size_t Row = 0; Row < NumSamples; Row++) {
+    for (size_t Param = 0; Param < NumParams; Param++)
+      Config[Param] = Sample.get(Row, Param);
+    if (Seen.insert(Config).second)
+      Unique.push_back(Row);
+  }
+  Batch.resize(Unique.size(), NumParams);
+  for (size_t Row = 0; Row < Unique.size(); Row++)
+    for (size_t Param = 0; Param < NumParams; Param++)
+      Batch.at(Row, Param) = Sample.get(Unique[Row], Param);
+  return Unique.size();
+}
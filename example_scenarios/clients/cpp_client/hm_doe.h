@@ -0,0 +1,23 @@
+#ifndef HM_DOE_H
+#define HM_DOE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpp_client.h"
+#include "hm_batch.h"
+
+// Client side design of experiments, so the first samples can be evaluated
+// while HyperMapper is still starting up.
+
+// Fills Batch with a Latin hypercube sample of NumSamples configurations of
+// Params: the range of every parameter is cut into NumSamples strata and
+// each stratum is used by exactly one configuration. Values are stored as
+// in a request batch, categories by index. The same Seed always gives the
+// same sample. Configurations drawn twice, possible when a parameter has
+// fewer values than NumSamples, are kept once; returns how many remain.
+size_t generateLatinHypercube(const std::vector<HMInputParam *> &Params,
+                              size_t NumSamples, uint64_t Seed,
+                              HMBatch &Batch);
+
+#endif
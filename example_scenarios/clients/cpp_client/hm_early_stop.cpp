@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "hm_early_stop.h"
+#include "hm_pareto.h"
+
+using namespace std;
+
+bool HMObjective::reportInterim(double Fidelity) {
+  return !EarlyStop || EarlyStop->report(Results, Row, Fidelity);
+}
+
+HMEarlyStop::HMEarlyStop(size_t _NumObjectives, size_t _FidelityColumn,
+                         double _Margin, double _MinFidelity)
+    : NumObjectives(_NumObjectives), FidelityColumn(_FidelityColumn),
+      Margin(_Margin), MinFidelity(_MinFidelity) {}
+
+void HMEarlyStop::reset(size_t NumRows) {
+  Fidelity.assign(NumRows, 1);
+  Stopped.assign(NumRows, 0);
+}
+
+bool HMEarlyStop::isDominated(const HMResults &Results, size_t Row,
+                              double Fidelity) const {
+  double Slack = Margin * (1 - min(Fidelity, 1.0));
+  shared_lock<shared_mutex> Lock(FrontLock);
+  for (size_t Point = 0; Point < Front.size(); Point += NumObjectives) {
+    bool NoWorse = true, Better = false;
+    for (size_t obj = 0; obj < NumObjectives && NoWorse; obj++) {
+      double Value = Results.objective(obj)[Row];
+      double Best = Value - Slack * fabs(Value);
+      NoWorse = Front[Point + obj] <= Best;
+      Better |= Front[Point + obj] < Value;
+    }
+    if (NoWorse && Better)
+      return true;
+  }
+  return false;
+}
+
+bool HMEarlyStop::report(HMResults &Results, size_t Row, double _Fidelity) {
+  Fidelity[Row] = _Fidelity;
+  if (Stopped[Row])
+    return false;
+  if (_Fidelity < MinFidelity)
+    return true;
+  // NaN estimates compare false and never stop
+  if (!isDominated(Results, Row, _Fidelity))
+    return true;
+  Stopped[Row] = 1;
+  return false;
+}
+
+void HMEarlyStop::finish(HMResults &Results, size_t Row) {
+  Results.at(Row, FidelityColumn) = Stopped[Row] ? Fidelity[Row] : 1;
+  if (Stopped[Row]) {
+    // Workers finish their rows concurrently
+    lock_guard<shared_mutex> Lock(FrontLock);
+    NumStopped++;
+    SavedBudget += 1 - Fidelity[Row];
+    return;
+  }
+  if (Results.feasible()[Row])
+    add(Results, Row);
+}
+
+void HMEarlyStop::add(const HMResults &Results, size_t Row) {
+  for (size_t obj = 0; obj < NumObjectives; obj++)
+    if (std::isnan(Results.objective(obj)[Row]))
+      return;
+  lock_guard<shared_mutex> Lock(FrontLock);
+  for (size_t obj = 0; obj < NumObjectives; obj++)
+    Front.push_back(Results.objective(obj)[Row]);
+  // Prune once the unpruned rows outnumber the front
+  size_t NumPoints = Front.size() / NumObjectives;
+  if (NumPoints < 2 * PrunedSize + 16)
+    return;
+  vector<size_t> Keep = computeParetoFront(Front, NumObjectives);
+  vector<double> Pruned;
+  Pruned.reserve(Keep.size() * NumObjectives);
+  for (size_t Point : Keep)
+    Pruned.insert(Pruned.end(), Front.begin() + Point * NumObjectives,
+                  Front.begin() + (Point + 1) * NumObjectives);
+  Front.swap(Pruned);
+  PrunedSize = Keep.size();
+}
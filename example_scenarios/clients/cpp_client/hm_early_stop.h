@@ -0,0 +1,78 @@
+#ifndef HM_EARLY_STOP_H
+#define HM_EARLY_STOP_H
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+#include "hm_batch.h"
+
+// Early termination of evaluations that cannot reach the Pareto front.
+//
+// Iterative objectives report interim estimates of their objectives with
+// HMObjective::reportInterim, together with their fidelity, the share of
+// their budget done. An estimate at fidelity F is assumed to improve by at
+// most Margin * (1 - F) of its value in each objective by the end of the
+// run. When even the improved estimate is dominated by a configuration
+// evaluated in full, the evaluation is stopped and reports its last
+// estimate, with the fidelity it reached in the Fidelity metric. As in
+// HyperMapper all objectives are minimized.
+//
+// The front of the configurations evaluated in full is shared by the
+// workers: reportInterim reads it concurrently and every finished
+// evaluation adds to it.
+class HMEarlyStop {
+public:
+  // Results of a batch have NumObjectives objectives and the fidelity in
+  // column FidelityColumn. Estimates below MinFidelity never stop.
+  HMEarlyStop(size_t NumObjectives, size_t FidelityColumn, double Margin,
+              double MinFidelity);
+
+  // Prepares for a batch of NumRows configurations
+  void reset(size_t NumRows);
+
+  // Records the estimate in row Row of Results at Fidelity. Returns false
+  // if the evaluation should stop.
+  bool report(HMResults &Results, size_t Row, double Fidelity);
+
+  // Called once the evaluation of row Row has returned: stores its
+  // fidelity and adds it to the front when it was evaluated in full and is
+  // feasible
+  void finish(HMResults &Results, size_t Row);
+
+  // Adds the objectives of a feasible configuration evaluated in full, e.g.
+  // one answered from the cache
+  void add(const HMResults &Results, size_t Row);
+
+  // Whether the evaluation of row Row was stopped
+  bool isStopped(size_t Row) const { return Stopped[Row]; }
+
+  // Stopped evaluations and the budget they saved, in evaluations
+  size_t getNumStopped() const { return NumStopped; }
+  double getSavedBudget() const { return SavedBudget; }
+
+private:
+  bool isDominated(const HMResults &Results, size_t Row,
+                   double Fidelity) const;
+
+  size_t NumObjectives;
+  size_t FidelityColumn;
+  double Margin;
+  double MinFidelity;
+
+  // Objectives of the front, row-major. Rows added since the last pruning
+  // may be dominated.
+  mutable std::shared_mutex FrontLock;
+  std::vector<double> Front;
+  size_t PrunedSize = 0;
+
+  // State of the rows of the current batch, each written only by the
+  // worker evaluating it
+  std::vector<double> Fidelity;
+  std::vector<uint8_t> Stopped;
+
+  size_t NumStopped = 0;
+  double SavedBudget = 0;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "hm_evaluator.h"
+
+using namespace std;
+
+HMEvaluator::HMEvaluator(unsigned NumWorkers, HMPlacement _Placement)
+    : Placement(_Placement), Plan(planPlacement(Placement, NumWorkers)),
+      CallerEvaluates(Placement == HMPlaceAny) {
+  // Unless the workers are pinned the calling thread also evaluates, so it
+  // counts as one of the workers.
+  for (size_t i = CallerEvaluates; i < Plan.Workers.size(); i++)
+    Threads.emplace_back(&HMEvaluator::workerLoop, this, i);
+}
+
+HMEvaluator::~HMEvaluator() {
+  {
+    lock_guard<mutex> Lock(Mutex);
+    Stop = true;
+  }
+  WorkCV.notify_all();
+  for (auto &T : Threads)
+    T.join();
+}
+
+void HMEvaluator::evaluate(size_t NumConfigs, const ObjectiveFn &_Fn) {
+  {
+    lock_guard<mutex> Lock(Mutex);
+    NumTasks = NumConfigs;
+    Fn = &_Fn;
+    Next = 0;
+    Error = nullptr;
+    ActiveWorkers = Threads.size();
+    Generation++;
+  }
+  WorkCV.notify_all();
+
+  if (CallerEvaluates)
+    runTasks();
+
+  unique_lock<mutex> Lock(Mutex);
+  DoneCV.wait(Lock, [this] { return ActiveWorkers == 0; });
+  NumTasks = 0;
+  Fn = nullptr;
+  if (Error)
+    rethrow_exception(Error);
+}
+
+void HMEvaluator::workerLoop(size_t Worker) {
+  pinThread(Plan.Workers[Worker]);
+  unsigned long Seen = 0;
+  while (true) {
+    {
+      unique_lock<mutex> Lock(Mutex);
+      WorkCV.wait(Lock, [&] { return Stop || Generation != Seen; });
+      if (Stop)
+        return;
+      Seen = Generation;
+    }
+    runTasks();
+    {
+      lock_guard<mutex> Lock(Mutex);
+      if (--ActiveWorkers == 0)
+        DoneCV.notify_one();
+    }
+  }
+}
+
+void HMEvaluator::runTasks() {
+  while (true) {
+    size_t Task = Next.fetch_add(1);
+    if (Task >= NumTasks)
+      return;
+    try {
+      (*Fn)(Task);
+    } catch (...) {
+      lock_guard<mutex> Lock(Mutex);
+      if (!Error)
+        Error = current_exception();
+      Next = NumTasks;
+    }
+  }
+}
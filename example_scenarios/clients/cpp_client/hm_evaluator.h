@@ -0,0 +1,70 @@
+#ifndef HM_EVALUATOR_H
+#define HM_EVALUATOR_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hm_affinity.h"
+
+// Thread pool that evaluates the configurations of a HyperMapper request
+// batch in parallel. Workers take the next unevaluated configuration from a
+// shared counter, so one slow evaluation never holds up the rest of the
+// batch. Each evaluation stores its result in the slot of its request, so
+// the response can be assembled in request order.
+class HMEvaluator {
+public:
+  // Evaluates the configuration with the given index in the batch and
+  // stores its result
+  using ObjectiveFn = std::function<void(size_t)>;
+
+  // NumWorkers is the total number of concurrent evaluations, including the
+  // calling thread. 0 means one per available hardware thread. With a
+  // Placement other than HMPlaceAny every worker is a thread of its own,
+  // pinned as planPlacement decides, and the calling thread only waits; 0
+  // then means one worker per core left for them.
+  explicit HMEvaluator(unsigned NumWorkers = 0,
+                       HMPlacement Placement = HMPlaceAny);
+  ~HMEvaluator();
+
+  HMEvaluator(const HMEvaluator &) = delete;
+  HMEvaluator &operator=(const HMEvaluator &) = delete;
+
+  unsigned getNumWorkers() const { return Threads.size() + CallerEvaluates; }
+
+  HMPlacement getPlacement() const { return Placement; }
+  // CPUs the thread calling evaluate should run on, empty for any
+  const HMCPUSet &getProtocolCPUs() const { return Plan.Protocol; }
+
+  // Runs Fn(i) for every i below NumConfigs. Blocks until the whole batch
+  // is done. If Fn throws, the remaining configurations are skipped and the
+  // first exception is rethrown here.
+  void evaluate(size_t NumConfigs, const ObjectiveFn &Fn);
+
+private:
+  void workerLoop(size_t Worker);
+  void runTasks();
+
+  HMPlacement Placement;
+  HMPlacementPlan Plan;
+  bool CallerEvaluates;
+  std::vector<std::thread> Threads;
+  std::mutex Mutex;
+  std::condition_variable WorkCV;
+  std::condition_variable DoneCV;
+  unsigned long Generation = 0;
+  unsigned ActiveWorkers = 0;
+  bool Stop = false;
+
+  // State of the batch currently being evaluated.
+  size_t NumTasks = 0;
+  const ObjectiveFn *Fn = nullptr;
+  std::atomic<size_t> Next{0};
+  std::exception_ptr Error;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HM_LOG_H
+#define HM_LOG_H
+#include <iostream>
+
+// Log levels of the HyperMapper client
+// - HMLogOff: no output at all
+// - HMLogSummary: start/end messages and one summary line per iteration
+// - HMLogTrace: additionally echoes every protocol message
+enum HMLogLevel { HMLogOff = 0, HMLogSummary = 1, HMLogTrace = 2 };
+
+// Highest level compiled in, e.g. -DHM_MAX_LOG_LEVEL=1 removes all trace
+// output from the binary.
+#ifndef HM_MAX_LOG_LEVEL
+#define HM_MAX_LOG_LEVEL 2
+#endif
+
+// Writes Msg (a chain of << operands) to cout if Level is enabled by both
+// HM_MAX_LOG_LEVEL and the runtime level Current. Msg is not evaluated
+// otherwise, so disabled messages cost no formatting work.
+#define HM_LOG(Current, Level, Msg)                                            \
+  do {                                                                         \
+    if ((Level) <= HM_MAX_LOG_LEVEL && (Level) <= (Current))                   \
+      std::cout << Msg;                                                        \
+  } while (0)
+
+// Returns the level named by Name ("off", "summary" or "trace"), or
+// Default if Name is null or not a level name.
+HMLogLevel parseLogLevel(const char *Name, HMLogLevel Default);
+
+#endif
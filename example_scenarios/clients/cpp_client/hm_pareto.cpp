@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_pareto.h"
+#include "hm_protocol.h"
+
+using namespace std;
+
+// Two objectives: after sorting by (f1, f2) a point is dominated iff a point
+// with smaller f1 has f2 no larger, or a point with equal f1 has smaller f2.
+static void computeParetoFront2(const vector<double> &Costs,
+                                vector<size_t> &Order, vector<size_t> &Front) {
+  sort(Order.begin(), Order.end(), [&](size_t A, size_t B) {
+    if (Costs[2 * A] != Costs[2 * B])
+      return Costs[2 * A] < Costs[2 * B];
+    return Costs[2 * A + 1] < Costs[2 * B + 1];
+  });
+  double BestF2 = numeric_limits<double>::infinity();
+  for (size_t Group = 0; Group < Order.size();) {
+    // Points sharing f1 are sorted by f2, so the first has the group minimum
+    double F1 = Costs[2 * Order[Group]];
+    double MinF2 = Costs[2 * Order[Group] + 1];
+    size_t End = Group;
+    while (End < Order.size() && Costs[2 * Order[End]] == F1)
+      End++;
+    if (MinF2 < BestF2) {
+      for (size_t i = Group; i < End && Costs[2 * Order[i] + 1] == MinF2; i++)
+        Front.push_back(Order[i]);
+      BestF2 = MinF2;
+    }
+    Group = End;
+  }
+}
+
+// Any number of objectives: in lexicographic order no point can dominate
+// one before it, so a point is non-dominated iff no point of the front
+// collected so far dominates it.
+static void computeParetoFrontK(const vector<double> &Costs, size_t K,
+                                vector<size_t> &Order, vector<size_t> &Front) {
+  const double *C = Costs.data();
+  sort(Order.begin(), Order.end(), [&](size_t A, size_t B) {
+    return lexicographical_compare(C + A * K, C + (A + 1) * K, C + B * K,
+                                   C + (B + 1) * K);
+  });
+  for (size_t Point : Order) {
+    const double *P = C + Point * K;
+    bool Dominated = false;
+    for (size_t Other : Front) {
+      const double *Q = C + Other * K;
+      bool NoWorse = true, Better = false;
+      for (size_t obj = 0; obj < K && NoWorse; obj++) {
+        NoWorse = Q[obj] <= P[obj];
+        Better |= Q[obj] < P[obj];
+      }
+      if (NoWorse && Better) {
+        Dominated = true;
+        break;
+      }
+    }
+    if (!Dominated)
+      Front.push_back(Point);
+  }
+}
+
+vector<size_t> computeParetoFront(const vector<double> &Costs,
+                                  size_t NumObjectives) {
+  vector<size_t> Order(NumObjectives ? Costs.size() / NumObjectives : 0);
+  iota(Order.begin(), Order.end(), 0);
+  vector<size_t> Front;
+  if (NumObjectives == 2)
+    computeParetoFront2(Costs, Order, Front);
+  else
+    computeParetoFrontK(Costs, NumObjectives, Order, Front);
+  sort(Front.begin(), Front.end());
+  return Front;
+}
+
+size_t writeParetoFile(const string &DataFile, const string &ParetoFile,
+                       const vector<string> &Objectives,
+                       const string &FeasibleName, const string &TrueValue) {
+  HMMappedFile Samples;
+  Samples.open(DataFile);
+  string_view Data = Samples.data();
+  string_view Header;
+  if (!nextLine(Data, Header))
+    fatalError("Empty samples file: " + DataFile);
+
+  // Locate the objective and feasibility columns
+  size_t K = Objectives.size();
+  vector<int> ObjectiveColumns(K, -1);
+  int FeasibleColumn = -1;
+  HMLineTokenizer Names(Header);
+  string_view Name;
+  for (int col = 0; Names.next(Name); col++) {
+    for (size_t obj = 0; obj < K; obj++)
+      if (Name == Objectives[obj])
+        ObjectiveColumns[obj] = col;
+    if (!FeasibleName.empty() && Name == FeasibleName)
+      FeasibleColumn = col;
+  }
+  for (size_t obj = 0; obj < K; obj++)
+    if (ObjectiveColumns[obj] < 0)
+      fatalError("Objective " + Objectives[obj] + " missing in " + DataFile);
+  if (!FeasibleName.empty() && FeasibleColumn < 0)
+    fatalError("Column " + FeasibleName + " missing in " + DataFile);
+
+  // Keep the feasible rows as views into the mapped file
+  vector<string_view> Rows;
+  vector<double> Costs;
+  vector<double> RowCosts(K);
+  string_view Row;
+  while (nextLine(Data, Row)) {
+    if (stripLineEnd(Row).empty())
+      continue;
+    HMLineTokenizer Fields(Row);
+    string_view Field;
+    bool Feasible = FeasibleColumn < 0;
+    size_t Found = 0;
+    for (int col = 0; Fields.next(Field); col++) {
+      if (col == FeasibleColumn)
+        Feasible = Field == TrueValue;
+      for (size_t obj = 0; obj < K; obj++) {
+        if (col != ObjectiveColumns[obj])
+          continue;
+        if (!parseField(Field, RowCosts[obj]))
+          fatalError("Malformed objective value in " + DataFile + ": " +
+                     string(stripLineEnd(Row)));
+        Found++;
+      }
+    }
+    if (Found != K)
+      fatalError("Missing objective values in " + DataFile + ": " +
+                 string(stripLineEnd(Row)));
+    if (!Feasible)
+      continue;
+    Rows.push_back(Row);
+    Costs.insert(Costs.end(), RowCosts.begin(), RowCosts.end());
+  }
+
+  vector<size_t> Front = computeParetoFront(Costs, K);
+
+  string Output;
+  auto appendLine = [&](string_view Line) {
+    Output.append(Line);
+    if (Line.back() != '\n')
+      Output += '\n';
+  };
+  appendLine(Header);
+  for (size_t Idx : Front)
+    appendLine(Rows[Idx]);
+  int FD = open(ParetoFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (FD < 0)
+    fatalError("Unable to open file: " + ParetoFile);
+  try {
+    writeAll(FD, Output);
+  } catch (...) {
+    close(FD);
+    throw;
+  }
+  close(FD);
+  return Front.size();
+}
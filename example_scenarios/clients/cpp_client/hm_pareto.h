@@ -0,0 +1,28 @@
+#ifndef HM_PARETO_H
+#define HM_PARETO_H
+#include <string>
+#include <vector>
+
+// Native replacement for compute_pareto.py. All objectives are minimized,
+// as in HyperMapper. A point is on the front unless another point is no
+// worse in every objective and strictly better in one, so duplicated
+// points on the front are all kept.
+
+// Returns the indices, in increasing order, of the non-dominated rows of
+// Costs, a row-major matrix with NumObjectives columns. Two objectives take
+// O(n log n), more objectives use a sort-filter sweep that compares each
+// point only against the front found so far.
+std::vector<size_t> computeParetoFront(const std::vector<double> &Costs,
+                                       size_t NumObjectives);
+
+// Reads the samples csv DataFile and writes the feasible non-dominated rows,
+// unchanged and in their original order, to ParetoFile under the same
+// header. Rows are feasible if their FeasibleName column equals TrueValue,
+// an empty FeasibleName keeps every row. Returns the size of the front.
+size_t writeParetoFile(const std::string &DataFile,
+                       const std::string &ParetoFile,
+                       const std::vector<std::string> &Objectives,
+                       const std::string &FeasibleName,
+                       const std::string &TrueValue);
+
+#endif
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "cpp_client.h"
+#include "hm_process_pool.h"
+
+using namespace std;
+
+enum : uint64_t { StatusOk = 0, StatusError = 1 };
+
+// Workers replaced per worker of the pool, with no evaluation returning in
+// between, after which the objective is taken to crash every worker
+constexpr size_t MaxRespawnsPerWorker = 3;
+
+// Reads exactly Size bytes from FD. Returns false on end of file or error.
+static bool readFrame(int FD, char *Data, size_t Size) {
+  while (Size > 0) {
+    ssize_t NumRead = read(FD, Data, Size);
+    if (NumRead < 0 && errno == EINTR)
+      continue;
+    if (NumRead <= 0)
+      return false;
+    Data += NumRead;
+    Size -= NumRead;
+  }
+  return true;
+}
+
+// Writes all Size bytes to FD. Returns false if the reader is gone.
+static bool writeFrame(int FD, const char *Data, size_t Size) {
+  while (Size > 0) {
+    ssize_t NumWritten = write(FD, Data, Size);
+    if (NumWritten < 0 && errno == EINTR)
+      continue;
+    if (NumWritten <= 0)
+      return false;
+    Data += NumWritten;
+    Size -= NumWritten;
+  }
+  return true;
+}
+
+// Closes every descriptor inherited from the client except stdio and Keep,
+// so a worker never holds the HyperMapper pipes or other workers' pipes
+static void closeInheritedFDs(int KeepA, int KeepB) {
+  vector<int> FDs;
+  if (DIR *D = opendir("/proc/self/fd")) {
+    while (dirent *Entry = readdir(D))
+      if (Entry->d_name[0] != '.')
+        FDs.push_back(atoi(Entry->d_name));
+    closedir(D);
+  } else {
+    for (int FD = 3; FD < 1024; FD++)
+      FDs.push_back(FD);
+  }
+  for (int FD : FDs)
+    if (FD > 2 && FD != KeepA && FD != KeepB)
+      close(FD);
+}
+
+HMProcessPool::HMProcessPool(unsigned NumWorkers, size_t _NumParams,
+                             size_t _NumObjectives, size_t _NumMetrics,
+                             double _Timeout, WorkerFn _Fn)
+    : NumParams(_NumParams), NumObjectives(_NumObjectives),
+      NumMetrics(_NumMetrics), Timeout(_Timeout), Fn(move(_Fn)) {
+  if (NumWorkers == 0)
+    NumWorkers = max(1u, thread::hardware_concurrency());
+  // Writing to a worker that just died must fail with EPIPE, not kill us
+  struct sigaction Ignore;
+  memset(&Ignore, 0, sizeof(Ignore));
+  Ignore.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &Ignore, &OldSigPipe);
+  Workers.resize(NumWorkers);
+  try {
+    for (Worker &W : Workers)
+      spawn(W);
+  } catch (...) {
+    for (Worker &W : Workers)
+      stop(W);
+    sigaction(SIGPIPE, &OldSigPipe, nullptr);
+    throw;
+  }
+}
+
+HMProcessPool::~HMProcessPool() {
+  for (Worker &W : Workers)
+    stop(W);
+  sigaction(SIGPIPE, &OldSigPipe, nullptr);
+}
+
+void HMProcessPool::spawn(Worker &W) {
+  int ToWorker[2], FromWorker[2];
+  if (pipe(ToWorker))
+    fatalError(string("Unable to create pipe: ") + strerror(errno));
+  if (pipe(FromWorker)) {
+    close(ToWorker[0]);
+    close(ToWorker[1]);
+    fatalError(string("Unable to create pipe: ") + strerror(errno));
+  }
+  cout.flush();
+  fflush(stdout);
+  pid_t Pid = fork();
+  if (Pid < 0) {
+    for (int FD : {ToWorker[0], ToWorker[1], FromWorker[0], FromWorker[1]})
+      close(FD);
+    fatalError(string("Unable to fork worker: ") + strerror(errno));
+  }
+  if (Pid == 0) {
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    closeInheritedFDs(ToWorker[0], FromWorker[1]);
+    workerMain(ToWorker[0], FromWorker[1]);
+    _exit(0);
+  }
+  close(ToWorker[0]);
+  close(FromWorker[1]);
+  W.Pid = Pid;
+  W.ToWorker = ToWorker[1];
+  W.FromWorker = FromWorker[0];
+  W.Busy = false;
+}
+
+void HMProcessPool::stop(Worker &W) {
+  if (W.Pid < 0)
+    return;
+  close(W.ToWorker);
+  close(W.FromWorker);
+  kill(W.Pid, SIGKILL);
+  waitpid(W.Pid, nullptr, 0);
+  W.Pid = -1;
+  W.ToWorker = W.FromWorker = -1;
+  W.Busy = false;
+}
+
+void HMProcessPool::workerMain(int In, int Out) {
+  size_t NumOutputs = NumObjectives + NumMetrics;
+  vector<char> Request(sizeof(uint64_t) + NumParams * sizeof(double));
+  vector<char> Reply(3 * sizeof(uint64_t) + NumOutputs * sizeof(double));
+  HMBatch Config;
+  HMResults Result;
+  while (readFrame(In, Request.data(), Request.size())) {
+    Config.resize(1, NumParams);
+    for (size_t p = 0; p < NumParams; p++)
+      memcpy(&Config.at(0, p),
+             Request.data() + sizeof(uint64_t) + p * sizeof(double),
+             sizeof(double));
+    Result.reset(1, NumObjectives, NumMetrics);
+    uint64_t Status = StatusOk;
+    try {
+      Fn(Config, Result);
+    } catch (const exception &E) {
+      cerr << "Evaluation failed: " << E.what() << endl;
+      Status = StatusError;
+    } catch (...) {
+      Status = StatusError;
+    }
+    uint64_t Feasible = Status == StatusOk && Result.feasible()[0];
+    char *Data = Reply.data();
+    memcpy(Data, Request.data(), sizeof(uint64_t));
+    memcpy(Data + sizeof(uint64_t), &Status, sizeof(Status));
+    memcpy(Data + 2 * sizeof(uint64_t), &Feasible, sizeof(Feasible));
+    for (size_t out = 0; out < NumOutputs; out++)
+      memcpy(Data + 3 * sizeof(uint64_t) + out * sizeof(double),
+             &Result.at(0, out), sizeof(double));
+    cout.flush();
+    if (!writeFrame(Out, Reply.data(), Reply.size()))
+      return;
+  }
+}
+
+bool HMProcessPool::dispatch(Worker &W, const HMBatch &Batch, size_t Config) {
+  Frame.resize(sizeof(uint64_t) + NumParams * sizeof(double));
+  uint64_t Id = Config;
+  memcpy(Frame.data(), &Id, sizeof(Id));
+  for (size_t p = 0; p < NumParams; p++) {
+    double Value = Batch.get(Config, p);
+    memcpy(Frame.data() + sizeof(uint64_t) + p * sizeof(double), &Value,
+           sizeof(Value));
+  }
+  if (!writeFrame(W.ToWorker, Frame.data(), Frame.size()))
+    return false;
+  W.Busy = true;
+  W.Config = Config;
+  if (Timeout > 0)
+    W.Deadline = chrono::steady_clock::now() +
+                 chrono::duration_cast<chrono::steady_clock::duration>(
+                     chrono::duration<double>(Timeout));
+  return true;
+}
+
+void HMProcessPool::evaluate(const HMBatch &Batch,
+                             const vector<size_t> &Configs,
+                             HMResults &Results, vector<uint8_t> &Failed,
+                             const RowFn &Completed) {
+  Failed.assign(Batch.size(), 0);
+  size_t NumOutputs = NumObjectives + NumMetrics;
+  vector<char> Reply(3 * sizeof(uint64_t) + NumOutputs * sizeof(double));
+  vector<pollfd> PollFDs;
+  vector<Worker *> Polled;
+  size_t Next = 0, Done = 0;
+  size_t Respawns = 0, MaxRespawns = MaxRespawnsPerWorker * Workers.size();
+
+  // Replaces a worker that died evaluating or about to evaluate Row,
+  // unless they keep dying; Row then fails with the batch
+  auto respawn = [&](Worker &W, size_t Row) {
+    stop(W);
+    if (++Respawns > MaxRespawns) {
+      Failed[Row] = 1;
+      Results.feasibleAt(Row) = 0;
+      fatalError("Worker processes keep exiting, gave up after " +
+                 to_string(MaxRespawns) + " restarts");
+    }
+    spawn(W);
+  };
+  auto fail = [&](Worker &W, bool Crashed) {
+    Failed[W.Config] = 1;
+    Results.feasibleAt(W.Config) = 0;
+    Done++;
+    if (Crashed) {
+      respawn(W, W.Config);
+    } else {
+      stop(W);
+      spawn(W);
+    }
+    if (Completed)
+      Completed(W.Config);
+  };
+
+  while (Done < Configs.size()) {
+    // Hand out configurations to idle workers
+    for (Worker &W : Workers) {
+      while (!W.Busy && Next < Configs.size()) {
+        if (dispatch(W, Batch, Configs[Next])) {
+          Next++;
+          break;
+        }
+        // The worker died while idle, replace it and retry
+        NumCrashes++;
+        respawn(W, Configs[Next]);
+      }
+    }
+
+    // Wait for a reply or the earliest deadline
+    PollFDs.clear();
+    Polled.clear();
+    auto Now = chrono::steady_clock::now();
+    int WaitMs = -1;
+    for (Worker &W : Workers) {
+      if (!W.Busy)
+        continue;
+      PollFDs.push_back({W.FromWorker, POLLIN, 0});
+      Polled.push_back(&W);
+      if (Timeout > 0) {
+        auto Left = chrono::duration_cast<chrono::milliseconds>(W.Deadline -
+                                                                Now);
+        int LeftMs = max<long>(0, Left.count() + 1);
+        WaitMs = WaitMs < 0 ? LeftMs : min(WaitMs, LeftMs);
+      }
+    }
+    int NumReady = poll(PollFDs.data(), PollFDs.size(), WaitMs);
+    if (NumReady < 0 && errno != EINTR)
+      fatalError(string("Error waiting for workers: ") + strerror(errno));
+
+    Now = chrono::steady_clock::now();
+    for (size_t i = 0; i < Polled.size(); i++) {
+      Worker &W = *Polled[i];
+      if (NumReady > 0 && PollFDs[i].revents) {
+        // A worker that exits mid-evaluation shows up as end of file
+        uint64_t Id = ~uint64_t(0), Status, Feasible;
+        if (readFrame(W.FromWorker, Reply.data(), Reply.size()))
+          memcpy(&Id, Reply.data(), sizeof(Id));
+        if (Id != W.Config) {
+          NumCrashes++;
+          fail(W, true);
+          continue;
+        }
+        memcpy(&Status, Reply.data() + sizeof(uint64_t), sizeof(Status));
+        memcpy(&Feasible, Reply.data() + 2 * sizeof(uint64_t),
+               sizeof(Feasible));
+        W.Busy = false;
+        Done++;
+        Respawns = 0;
+        if (Status != StatusOk) {
+          Failed[W.Config] = 1;
+          Results.feasibleAt(W.Config) = 0;
+          if (Completed)
+            Completed(W.Config);
+          continue;
+        }
+        for (size_t out = 0; out < NumOutputs; out++)
+          memcpy(&Results.at(W.Config, out),
+                 Reply.data() + 3 * sizeof(uint64_t) + out * sizeof(double),
+                 sizeof(double));
+        Results.feasibleAt(W.Config) = Feasible;
+        if (Completed)
+          Completed(W.Config);
+      } else if (Timeout > 0 && Now >= W.Deadline) {
+        NumTimeouts++;
+        fail(W, false);
+      }
+    }
+  }
+}
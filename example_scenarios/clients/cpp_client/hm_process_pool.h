@@ -0,0 +1,81 @@
+#ifndef HM_PROCESS_POOL_H
+#define HM_PROCESS_POOL_H
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sys/types.h>
+#include <vector>
+
+#include "hm_batch.h"
+
+// Pool of forked worker processes that evaluate configurations outside the
+// client. Every evaluation has a wall-clock timeout: a worker that exceeds
+// it, or crashes, is killed and replaced and its configuration reported as
+// failed, so a batch never waits longer than the timeout for an outlier.
+//
+// The parent sends each worker one fixed size frame per configuration (a
+// task id and the parameter values) and receives one fixed size frame back
+// (the task id, a status, the outputs and the feasibility).
+class HMProcessPool {
+public:
+  // Evaluates the only configuration of Config into the only row of Result.
+  // Runs in the worker process.
+  using WorkerFn = std::function<void(const HMBatch &Config,
+                                      HMResults &Result)>;
+  // Called in the calling thread with every row whose result is stored
+  using RowFn = std::function<void(size_t Row)>;
+
+  // Forks NumWorkers workers (0 = one per hardware thread) that run Fn.
+  // Timeout is in seconds, 0 disables it.
+  HMProcessPool(unsigned NumWorkers, size_t NumParams, size_t NumObjectives,
+                size_t NumMetrics, double Timeout, WorkerFn Fn);
+  ~HMProcessPool();
+
+  HMProcessPool(const HMProcessPool &) = delete;
+  HMProcessPool &operator=(const HMProcessPool &) = delete;
+
+  unsigned getNumWorkers() const { return Workers.size(); }
+
+  // Evaluates the rows Configs of Batch and stores their results in
+  // Results. Failed[Row] is set for the rows that timed out, crashed or
+  // threw; those are infeasible and keep NaN outputs. Completed is called
+  // with each row as soon as it is done. Throws HMError when the workers
+  // keep crashing: after three replacements per worker with no evaluation
+  // returning in between.
+  void evaluate(const HMBatch &Batch, const std::vector<size_t> &Configs,
+                HMResults &Results, std::vector<uint8_t> &Failed,
+                const RowFn &Completed = nullptr);
+
+  size_t getNumTimeouts() const { return NumTimeouts; }
+  size_t getNumCrashes() const { return NumCrashes; }
+
+private:
+  struct Worker {
+    pid_t Pid = -1;
+    int ToWorker = -1;
+    int FromWorker = -1;
+    bool Busy = false;
+    size_t Config = 0;
+    std::chrono::steady_clock::time_point Deadline;
+  };
+
+  void spawn(Worker &W);
+  void stop(Worker &W);
+  bool dispatch(Worker &W, const HMBatch &Batch, size_t Config);
+  void workerMain(int In, int Out);
+
+  size_t NumParams;
+  size_t NumObjectives;
+  size_t NumMetrics;
+  double Timeout;
+  WorkerFn Fn;
+  std::vector<Worker> Workers;
+  std::vector<char> Frame;
+  struct sigaction OldSigPipe;
+  size_t NumTimeouts = 0;
+  size_t NumCrashes = 0;
+};
+
+#endif
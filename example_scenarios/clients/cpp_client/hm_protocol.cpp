@@ -0,0 +1,189 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_protocol.h"
+
+using namespace std;
+
+bool HMLineReader::fill() {
+  // Make room for more data: move the data still needed to the front and
+  // only grow the buffer when that data alone fills it.
+  size_t From = Keep == NoKeep ? Begin : Keep;
+  if (From == End) {
+    Begin = End = 0;
+    if (Keep != NoKeep)
+      Keep = 0;
+  } else if (End == Buffer.size() && From > 0) {
+    memmove(Buffer.data(), Buffer.data() + From, End - From);
+    Begin -= From;
+    End -= From;
+    if (Keep != NoKeep)
+      Keep -= From;
+  }
+  if (End == Buffer.size())
+    Buffer.resize(2 * Buffer.size());
+
+  while (true) {
+    ssize_t NumRead = read(FD, Buffer.data() + End, Buffer.size() - End);
+    if (NumRead < 0) {
+      if (errno == EINTR)
+        continue;
+      fatalError(string("Error reading from HyperMapper: ") + strerror(errno));
+    }
+    End += NumRead;
+    return NumRead > 0;
+  }
+}
+
+bool HMLineReader::nextLine(size_t &Offset, size_t &Len) {
+  while (true) {
+    char *Start = Buffer.data() + Begin;
+    char *NewLine = static_cast<char *>(
+        memchr(Start + Scanned, '\n', End - Begin - Scanned));
+    if (NewLine) {
+      Offset = Begin;
+      Len = NewLine - Start + 1;
+      Begin += Len;
+      Scanned = 0;
+      return true;
+    }
+    Scanned = End - Begin;
+
+    if (!fill()) {
+      if (Begin == End)
+        return false;
+      Offset = Begin;
+      Len = End - Begin;
+      Begin = End;
+      Scanned = 0;
+      return true;
+    }
+  }
+}
+
+bool HMLineReader::readBytes(size_t Size, string_view &Data) {
+  while (End - Begin < Size)
+    if (!fill())
+      return false;
+  Data = string_view(Buffer.data() + Begin, Size);
+  Begin += Size;
+  Scanned = 0;
+  return true;
+}
+
+bool HMLineReader::readLine(string_view &Line) {
+  size_t Offset, Len;
+  if (!nextLine(Offset, Len))
+    return false;
+  Line = string_view(Buffer.data() + Offset, Len);
+  return true;
+}
+
+bool HMLineReader::readLines(size_t NumLines, vector<string_view> &Lines) {
+  // Offsets are kept relative to Keep, which moves when the buffer is
+  // compacted.
+  Keep = Begin;
+  LineOffsets.clear();
+  size_t Offset, Len;
+  for (size_t i = 0; i < NumLines; i++) {
+    if (!nextLine(Offset, Len)) {
+      Keep = NoKeep;
+      return false;
+    }
+    LineOffsets.emplace_back(Offset - Keep, Len);
+  }
+  Lines.resize(NumLines);
+  for (size_t i = 0; i < NumLines; i++)
+    Lines[i] = string_view(Buffer.data() + Keep + LineOffsets[i].first,
+                           LineOffsets[i].second);
+  Keep = NoKeep;
+  return true;
+}
+
+void writeAll(int FD, string_view Data) {
+  while (!Data.empty()) {
+    ssize_t Written = write(FD, Data.data(), Data.size());
+    if (Written < 0) {
+      if (errno == EINTR)
+        continue;
+      fatalError(string("Error writing to HyperMapper: ") + strerror(errno));
+    }
+    Data.remove_prefix(Written);
+  }
+}
+
+void HMMappedFile::open(const string &Path) {
+  close();
+  int FD = ::open(Path.c_str(), O_RDONLY);
+  if (FD < 0)
+    fatalError("Unable to open file: " + Path);
+  struct stat Stat;
+  if (fstat(FD, &Stat) || Stat.st_size == 0) {
+    ::close(FD);
+    fatalError("Unable to read file: " + Path);
+  }
+  void *Map = mmap(nullptr, Stat.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+  ::close(FD);
+  if (Map == MAP_FAILED)
+    fatalError("Unable to map file: " + Path);
+  madvise(Map, Stat.st_size, MADV_SEQUENTIAL);
+  Data = static_cast<const char *>(Map);
+  Size = Stat.st_size;
+}
+
+void HMMappedFile::close() {
+  if (Data)
+    munmap(const_cast<char *>(Data), Size);
+  Data = nullptr;
+  Size = 0;
+}
+
+HMHeaderMap::HMHeaderMap(const vector<HMInputParam *> &InParams) {
+  // Reserved up front so the views of the index keep pointing at the keys
+  Keys.reserve(InParams.size());
+  KeyIndex.reserve(InParams.size());
+  for (size_t i = 0; i < InParams.size(); i++)
+    KeyIndex.emplace(Keys.emplace_back(getParamKey(i)), i);
+}
+
+bool HMHeaderMap::update(string_view Header) {
+  Header = stripLineEnd(Header);
+  if (!LastHeader.empty() && Header == LastHeader)
+    return false;
+
+  ColumnToParam.assign(KeyIndex.size(), -1);
+  vector<bool> Seen(KeyIndex.size(), false);
+  HMLineTokenizer Tokenizer(Header);
+  string_view Key;
+  for (size_t Column = 0; Column < KeyIndex.size(); Column++) {
+    if (!Tokenizer.next(Key))
+      fatalError("Missing parameters in request header!");
+    auto It = KeyIndex.find(Key);
+    if (It == KeyIndex.end())
+      fatalError("Unknown parameter received: " + string(Key));
+    if (Seen[It->second])
+      fatalError("Duplicate parameter received: " + string(Key));
+    Seen[It->second] = true;
+    ColumnToParam[Column] = It->second;
+  }
+  if (Tokenizer.next(Key))
+    fatalError("Unexpected column in request header: " + string(Key));
+  LastHeader.assign(Header);
+  return true;
+}
+
+HMValueParser::HMValueParser(const vector<HMInputParam *> &InParams)
+    : CategoryIndex(InParams.size()) {
+  for (size_t i = 0; i < InParams.size(); i++) {
+    if (InParams[i]->getType() != Categorical)
+      continue;
+    const vector<string> &Categories = InParams[i]->getCategories();
+    for (size_t c = 0; c < Categories.size(); c++)
+      CategoryIndex[i].emplace(Categories[c], c);
+  }
+}
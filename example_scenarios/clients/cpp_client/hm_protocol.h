@@ -0,0 +1,290 @@
+#ifndef HM_PROTOCOL_H
+#define HM_PROTOCOL_H
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class HMInputParam;
+
+// Helpers for parsing the HyperMapper client-server text protocol in place.
+// Fields are returned as views into the received line, so no field is
+// copied or allocated while a request is parsed.
+
+// Removes the line terminator ("\n" or "\r\n") from a received line
+inline std::string_view stripLineEnd(std::string_view Line) {
+  while (!Line.empty() && (Line.back() == '\n' || Line.back() == '\r'))
+    Line.remove_suffix(1);
+  return Line;
+}
+
+// Reads newline terminated lines of any length from a file descriptor.
+// The buffer grows to fit the longest line seen so far and is then reused,
+// so once warmed up reading a line does not allocate.
+class HMLineReader {
+private:
+  int FD;
+  std::vector<char> Buffer;
+  // Unread data is Buffer[Begin, End). The first Scanned bytes of it are
+  // known not to contain a newline. While reading a group of lines, data
+  // from Keep on is not discarded.
+  size_t Begin = 0;
+  size_t End = 0;
+  size_t Scanned = 0;
+  size_t Keep = NoKeep;
+  std::vector<std::pair<size_t, size_t>> LineOffsets;
+
+  static constexpr size_t NoKeep = ~size_t(0);
+
+  bool fill();
+  bool nextLine(size_t &Offset, size_t &Len);
+
+public:
+  explicit HMLineReader(int _FD, size_t InitialSize = 1 << 20)
+      : FD(_FD), Buffer(InitialSize) {}
+
+  // Stores the next line, including its '\n', in Line. The view is valid
+  // until the next call. On end of file a final unterminated line is still
+  // returned, after that readLine returns false.
+  bool readLine(std::string_view &Line);
+
+  // Reads the next NumLines lines into Lines. The views stay valid until
+  // the next call, so a whole request batch can be used in place. Returns
+  // false if the input ends first.
+  bool readLines(size_t NumLines, std::vector<std::string_view> &Lines);
+
+  // Reads exactly Size bytes of binary data. The view is valid until the
+  // next call. Returns false if the input ends first.
+  bool readBytes(size_t Size, std::string_view &Data);
+
+  // Number of bytes received but not read yet
+  size_t getBufferedSize() const { return End - Begin; }
+};
+
+// Builds the reply to a request batch in one buffer that is reused for
+// every batch. Numbers are formatted with std::to_chars straight into it.
+class HMResponseWriter {
+private:
+  std::string Buffer;
+
+public:
+  // Starts a new reply, keeping the allocated capacity
+  void clear() { Buffer.clear(); }
+  void reserve(size_t Bytes) { Buffer.reserve(Bytes); }
+  void swap(HMResponseWriter &Other) { Buffer.swap(Other.Buffer); }
+
+  void append(std::string_view Bytes) { Buffer.append(Bytes); }
+  void append(char C) { Buffer.push_back(C); }
+
+  // Appends Value as 8 little-endian bytes
+  void appendLE(double Value) {
+    uint64_t Bits;
+    std::memcpy(&Bits, &Value, sizeof(Bits));
+    appendLE(Bits);
+  }
+  void appendLE(uint64_t Bits) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    Bits = __builtin_bswap64(Bits);
+#endif
+    Buffer.append(reinterpret_cast<const char *>(&Bits), sizeof(Bits));
+  }
+
+  template <typename T> void appendNumber(T Value) {
+    constexpr size_t MaxChars = 32;
+    size_t Size = Buffer.size();
+    Buffer.resize(Size + MaxChars);
+    auto Result =
+        std::to_chars(Buffer.data() + Size, Buffer.data() + Size + MaxChars,
+                      Value);
+    Buffer.resize(Result.ptr - Buffer.data());
+  }
+
+  std::string_view data() const { return Buffer; }
+};
+
+// Reads the little-endian 8 byte value at byte offset Offset of Data
+inline uint64_t readLE64(std::string_view Data, size_t Offset) {
+  uint64_t Bits;
+  std::memcpy(&Bits, Data.data() + Offset, sizeof(Bits));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  Bits = __builtin_bswap64(Bits);
+#endif
+  return Bits;
+}
+
+inline double readLEDouble(std::string_view Data, size_t Offset) {
+  uint64_t Bits = readLE64(Data, Offset);
+  double Value;
+  std::memcpy(&Value, &Bits, sizeof(Value));
+  return Value;
+}
+
+// Writes all of Data to FD
+void writeAll(int FD, std::string_view Data);
+
+// Read-only memory mapping of a whole file, used for the file-based
+// protocol where requests are exchanged through a csv file
+class HMMappedFile {
+private:
+  const char *Data = nullptr;
+  size_t Size = 0;
+
+public:
+  HMMappedFile() = default;
+  ~HMMappedFile() { close(); }
+  HMMappedFile(const HMMappedFile &) = delete;
+  HMMappedFile &operator=(const HMMappedFile &) = delete;
+
+  // Maps the file at Path, replacing any previous mapping
+  void open(const std::string &Path);
+  void close();
+
+  std::string_view data() const { return std::string_view(Data, Size); }
+};
+
+// Splits the next line, including its '\n', off the front of Data. Returns
+// false once Data is empty.
+inline bool nextLine(std::string_view &Data, std::string_view &Line) {
+  if (Data.empty())
+    return false;
+  size_t NewLine = Data.find('\n');
+  size_t Len = NewLine == std::string_view::npos ? Data.size() : NewLine + 1;
+  Line = Data.substr(0, Len);
+  Data.remove_prefix(Len);
+  return true;
+}
+
+// Splits one protocol line into its comma separated fields
+class HMLineTokenizer {
+private:
+  std::string_view Rest;
+  bool Done;
+
+public:
+  explicit HMLineTokenizer(std::string_view Line)
+      : Rest(stripLineEnd(Line)), Done(false) {}
+
+  // Stores the next field in Field. Returns false once all fields of the
+  // line have been returned.
+  bool next(std::string_view &Field) {
+    if (Done)
+      return false;
+    size_t Comma = Rest.find(',');
+    if (Comma == std::string_view::npos) {
+      Field = Rest;
+      Done = true;
+    } else {
+      Field = Rest.substr(0, Comma);
+      Rest.remove_prefix(Comma + 1);
+    }
+    return true;
+  }
+};
+
+// Maps the columns of a request header to positions in the input parameter
+// list. The key index is built once per study and the column permutation
+// is only recomputed when the header line changes.
+class HMHeaderMap {
+private:
+  // Keys of the parameters, see getParamKey. The index refers to them, so
+  // the map cannot be copied.
+  std::vector<std::string> Keys;
+  std::unordered_map<std::string_view, int> KeyIndex;
+  std::string LastHeader;
+  std::vector<int> ColumnToParam;
+
+public:
+  explicit HMHeaderMap(const std::vector<HMInputParam *> &InParams);
+  HMHeaderMap(const HMHeaderMap &) = delete;
+  HMHeaderMap &operator=(const HMHeaderMap &) = delete;
+
+  // Updates the permutation for the header line Header. Returns true if it
+  // differs from the previous header. A header that does not name every
+  // parameter exactly once is a fatal error.
+  bool update(std::string_view Header);
+
+  // InParams position of the parameter in column Column
+  int operator[](int Column) const { return ColumnToParam[Column]; }
+};
+
+// Parses a whole field as a number. Returns false if the field is empty,
+// malformed or has trailing characters.
+template <typename T> inline bool parseField(std::string_view Field, T &Value) {
+  const char *End = Field.data() + Field.size();
+  auto Result = std::from_chars(Field.data(), End, Value);
+  return Result.ec == std::errc() && Result.ptr == End;
+}
+
+// Converts the fields of a request line to the values stored in HMBatch:
+// the number for real, integer and ordinal parameters and the category
+// index for categorical ones.
+class HMValueParser {
+private:
+  std::vector<std::unordered_map<std::string_view, double>> CategoryIndex;
+
+public:
+  // InParams must outlive the parser, the index refers to their categories
+  explicit HMValueParser(const std::vector<HMInputParam *> &InParams);
+
+  // Parses Field as a value of InParams[Param]. Returns false if it is not
+  // a number or not one of the categories.
+  bool parse(int Param, std::string_view Field, double &Value) const {
+    if (CategoryIndex[Param].empty())
+      return parseField(Field, Value);
+    auto It = CategoryIndex[Param].find(Field);
+    if (It == CategoryIndex[Param].end())
+      return false;
+    Value = It->second;
+    return true;
+  }
+
+  // Number of categories of InParams[Param], 0 if it is not categorical
+  size_t getNumCategories(int Param) const {
+    return CategoryIndex[Param].size();
+  }
+};
+
+// Parses the "Request N" message that starts every batch
+inline bool parseRequestLine(std::string_view Line, int &NumRequests) {
+  Line = stripLineEnd(Line);
+  constexpr std::string_view Prefix = "Request ";
+  if (Line.substr(0, Prefix.size()) != Prefix)
+    return false;
+  return parseField(Line.substr(Prefix.size()), NumRequests) &&
+         NumRequests >= 0;
+}
+
+// Parses the "FRequest N <file>" message of the file-based protocol,
+// where the batch is stored in a csv file instead of sent over the pipe
+inline bool parseFileRequestLine(std::string_view Line, int &NumRequests,
+                                 std::string_view &Path) {
+  Line = stripLineEnd(Line);
+  constexpr std::string_view Prefix = "FRequest ";
+  if (Line.substr(0, Prefix.size()) != Prefix)
+    return false;
+  Line.remove_prefix(Prefix.size());
+  size_t Space = Line.find(' ');
+  if (Space == std::string_view::npos)
+    return false;
+  Path = Line.substr(Space + 1);
+  return parseField(Line.substr(0, Space), NumRequests) && NumRequests >= 0 &&
+         !Path.empty();
+}
+
+// Parses the "BRequest N" message of the binary protocol
+inline bool parseBinaryRequestLine(std::string_view Line, int &NumRequests) {
+  Line = stripLineEnd(Line);
+  constexpr std::string_view Prefix = "BRequest ";
+  if (Line.substr(0, Prefix.size()) != Prefix)
+    return false;
+  return parseField(Line.substr(Prefix.size()), NumRequests) &&
+         NumRequests >= 0;
+}
+
+#endif
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_remote.h"
+#include "hm_transport.h"
+
+using namespace std;
+
+enum : uint64_t { StatusOk = 0, StatusError = 1 };
+
+static size_t requestFrameSize(size_t NumParams) {
+  return (1 + NumParams) * sizeof(uint64_t);
+}
+
+static size_t replyFrameSize(size_t NumOutputs) {
+  return (3 + NumOutputs) * sizeof(uint64_t);
+}
+
+// Sends all of Data. Returns false if the peer is gone.
+static bool sendAll(int FD, string_view Data) {
+  while (!Data.empty()) {
+    ssize_t Sent = send(FD, Data.data(), Data.size(), MSG_NOSIGNAL);
+    if (Sent < 0 && errno == EINTR)
+      continue;
+    if (Sent <= 0)
+      return false;
+    Data.remove_prefix(Sent);
+  }
+  return true;
+}
+
+HMRemotePool::HMRemotePool(const vector<string> &Addresses,
+                           uint64_t Signature, size_t _NumParams,
+                           size_t _NumObjectives, size_t _NumMetrics,
+                           HMLogLevel _LogLevel)
+    : NumParams(_NumParams), NumObjectives(_NumObjectives),
+      NumMetrics(_NumMetrics), LogLevel(_LogLevel), Agents(Addresses.size()) {
+  string Hello = "HMAgent 1 " + to_string(Signature) + " " +
+                 to_string(NumParams) + " " + to_string(NumObjectives) + " " +
+                 to_string(NumMetrics) + "\n";
+  for (size_t i = 0; i < Addresses.size(); i++) {
+    Agent &A = Agents[i];
+    A.Address = Addresses[i];
+    A.FD = connectSocket(A.Address);
+    A.Reader.reset(new HMLineReader(A.FD, 1 << 16));
+    string_view Line;
+    if (!sendAll(A.FD, Hello) || !A.Reader->readLine(Line))
+      fatalError("Agent " + A.Address + " closed the connection");
+    constexpr string_view Ready = "Ready ";
+    Line = stripLineEnd(Line);
+    if (Line.substr(0, Ready.size()) != Ready ||
+        !parseField(Line.substr(Ready.size()), A.Slots) || A.Slots == 0)
+      fatalError("Agent " + A.Address + " refused the study: " +
+                 string(Line));
+    HM_LOG(LogLevel, HMLogSummary,
+           "Connected to agent " << A.Address << " with " << A.Slots
+                                 << " slots" << endl);
+  }
+}
+
+HMRemotePool::~HMRemotePool() {
+  for (Agent &A : Agents)
+    if (A.FD >= 0)
+      close(A.FD);
+}
+
+unsigned HMRemotePool::getNumSlots() const {
+  unsigned Slots = 0;
+  for (const Agent &A : Agents)
+    if (A.FD >= 0)
+      Slots += A.Slots;
+  return Slots;
+}
+
+void HMRemotePool::disconnect(Agent &A) {
+  HM_LOG(LogLevel, HMLogSummary,
+         "Lost agent " << A.Address << ", sending its " << A.InFlight.size()
+                       << " configurations to the other agents" << endl);
+  close(A.FD);
+  A.FD = -1;
+  A.Reader.reset();
+}
+
+void HMRemotePool::evaluate(const HMBatch &Batch, const vector<size_t> &Configs,
+                            HMResults &Results, vector<uint8_t> &Failed,
+                            const HMProcessPool::RowFn &Completed) {
+  size_t NumOutputs = NumObjectives + NumMetrics;
+  size_t ReplySize = replyFrameSize(NumOutputs);
+  deque<size_t> Pending(Configs.begin(), Configs.end());
+  size_t Done = 0;
+  vector<pollfd> PollFDs;
+  vector<Agent *> Polled;
+
+  auto lose = [&](Agent &A) {
+    disconnect(A);
+    Pending.insert(Pending.begin(), A.InFlight.begin(), A.InFlight.end());
+    A.InFlight.clear();
+  };
+
+  while (Done < Configs.size()) {
+    // Queue configurations on the agents with the shortest queues
+    while (!Pending.empty()) {
+      Agent *Best = nullptr;
+      for (Agent &A : Agents) {
+        if (A.FD < 0 || A.InFlight.size() >= 2 * A.Slots)
+          continue;
+        if (!Best || A.InFlight.size() * Best->Slots <
+                         Best->InFlight.size() * A.Slots)
+          Best = &A;
+      }
+      if (!Best)
+        break;
+      size_t Config = Pending.front();
+      Frame.clear();
+      Frame.appendLE(uint64_t(Config));
+      for (size_t p = 0; p < NumParams; p++)
+        Frame.appendLE(Batch.get(Config, p));
+      if (!sendAll(Best->FD, Frame.data())) {
+        lose(*Best);
+        continue;
+      }
+      Pending.pop_front();
+      Best->InFlight.push_back(Config);
+    }
+    if (getNumSlots() == 0)
+      fatalError("All evaluation agents disconnected");
+
+    PollFDs.clear();
+    Polled.clear();
+    for (Agent &A : Agents) {
+      if (A.FD < 0 || A.InFlight.empty())
+        continue;
+      PollFDs.push_back({A.FD, POLLIN, 0});
+      Polled.push_back(&A);
+    }
+    if (poll(PollFDs.data(), PollFDs.size(), -1) < 0 && errno != EINTR)
+      fatalError(string("Error waiting for agents: ") + strerror(errno));
+
+    for (size_t i = 0; i < Polled.size(); i++) {
+      Agent &A = *Polled[i];
+      if (!PollFDs[i].revents)
+        continue;
+      // Take every complete reply, the first read waits for the rest of a
+      // partially received one
+      do {
+        string_view Reply;
+        bool Received;
+        try {
+          Received = A.Reader->readBytes(ReplySize, Reply);
+        } catch (const HMError &) {
+          Received = false;
+        }
+        uint64_t Config = Received ? readLE64(Reply, 0) : ~uint64_t(0);
+        auto It = find(A.InFlight.begin(), A.InFlight.end(), Config);
+        if (It == A.InFlight.end()) {
+          lose(A);
+          break;
+        }
+        A.InFlight.erase(It);
+        Done++;
+        if (readLE64(Reply, sizeof(uint64_t)) != StatusOk) {
+          Failed[Config] = 1;
+          Results.feasibleAt(Config) = 0;
+        } else {
+          Results.feasibleAt(Config) = readLE64(Reply, 2 * sizeof(uint64_t));
+          for (size_t out = 0; out < NumOutputs; out++)
+            Results.at(Config, out) =
+                readLEDouble(Reply, (3 + out) * sizeof(uint64_t));
+        }
+        if (Completed)
+          Completed(Config);
+      } while (A.Reader->getBufferedSize() >= ReplySize);
+    }
+  }
+}
+
+namespace {
+// Connection of a coordinator to an agent and the configurations it sent
+// that no worker has taken yet
+struct HMAgentConnection {
+  int FD;
+  bool Ready = false;
+  deque<vector<char>> Tasks;
+  unsigned Running = 0;
+  mutex SendMutex;
+};
+
+// Evaluation threads of an agent, shared by every coordinator connected to
+// it. Each coordinator is served from a thread of its own, and the workers
+// take the configurations of the coordinators in turn, so concurrent
+// coordinators split the slots.
+class HMAgentWorkers {
+public:
+  HMAgentWorkers(unsigned Slots, const HMScenario &Scenario,
+                 const HMObjectiveFn &Objective);
+  // Disconnects the coordinators and waits for their threads
+  ~HMAgentWorkers();
+
+  // Serves the coordinator connected on FD on a new thread and closes FD
+  // when it disconnects
+  void serve(int FD);
+
+private:
+  void serveCoordinator(HMAgentConnection &C);
+  void workerLoop();
+
+  unsigned Slots;
+  const HMScenario &Scenario;
+  const HMObjectiveFn &Objective;
+  size_t NumParams, NumObjectives, NumMetrics;
+  mutex Mutex;
+  condition_variable WorkCV, IdleCV;
+  // Connected coordinators, the next to take a configuration from first
+  list<HMAgentConnection *> Connections;
+  size_t NumServing = 0;
+  bool Stop = false;
+  vector<thread> Workers;
+};
+} // namespace
+
+HMAgentWorkers::HMAgentWorkers(unsigned _Slots, const HMScenario &_Scenario,
+                               const HMObjectiveFn &_Objective)
+    : Slots(_Slots), Scenario(_Scenario), Objective(_Objective),
+      NumParams(Scenario.InParams.size()),
+      NumObjectives(Scenario.Objectives.size()),
+      NumMetrics(Scenario.Metrics.size()) {
+  for (unsigned i = 0; i < Slots; i++)
+    Workers.emplace_back(&HMAgentWorkers::workerLoop, this);
+}
+
+HMAgentWorkers::~HMAgentWorkers() {
+  unique_lock<mutex> Lock(Mutex);
+  Stop = true;
+  for (HMAgentConnection *C : Connections)
+    shutdown(C->FD, SHUT_RDWR);
+  IdleCV.wait(Lock, [this] { return NumServing == 0; });
+  Lock.unlock();
+  WorkCV.notify_all();
+  for (auto &T : Workers)
+    T.join();
+}
+
+void HMAgentWorkers::serve(int FD) {
+  {
+    lock_guard<mutex> Lock(Mutex);
+    NumServing++;
+  }
+  thread([this, FD] {
+    HMAgentConnection C;
+    C.FD = FD;
+    {
+      lock_guard<mutex> Lock(Mutex);
+      if (Stop)
+        shutdown(FD, SHUT_RDWR);
+      Connections.push_back(&C);
+    }
+    cout << "Coordinator connected" << endl;
+    try {
+      serveCoordinator(C);
+    } catch (const HMError &E) {
+      cerr << E.what() << endl;
+    }
+    // Configurations not started are dropped, the coordinator sends them
+    // to another agent
+    unique_lock<mutex> Lock(Mutex);
+    Connections.remove(&C);
+    C.Tasks.clear();
+    IdleCV.wait(Lock, [&] { return C.Running == 0; });
+    close(FD);
+    cout << "Coordinator disconnected" << endl;
+    NumServing--;
+    IdleCV.notify_all();
+  }).detach();
+}
+
+// Serves one coordinator connection until it disconnects
+void HMAgentWorkers::serveCoordinator(HMAgentConnection &C) {
+  HMLineReader Reader(C.FD, 1 << 16);
+  string_view Line;
+  if (!Reader.readLine(Line))
+    return;
+  ostringstream Expected;
+  Expected << "HMAgent 1 " << getScenarioSignature(Scenario) << " "
+           << NumParams << " " << NumObjectives << " " << NumMetrics;
+  if (stripLineEnd(Line) != Expected.str()) {
+    cerr << "Refusing coordinator: " << stripLineEnd(Line) << endl;
+    sendAll(C.FD, "Error the agent runs a different scenario\n");
+    return;
+  }
+  // The coordinators connected already keep the slots they were given, the
+  // workers balance them
+  unsigned Share;
+  {
+    lock_guard<mutex> Lock(Mutex);
+    C.Ready = true;
+    size_t NumReady = count_if(Connections.begin(), Connections.end(),
+                               [](HMAgentConnection *A) { return A->Ready; });
+    Share = max<unsigned>(1, Slots / NumReady);
+  }
+  if (!sendAll(C.FD, "Ready " + to_string(Share) + "\n"))
+    return;
+
+  size_t RequestSize = requestFrameSize(NumParams);
+  string_view Request;
+  while (Reader.readBytes(RequestSize, Request)) {
+    lock_guard<mutex> Lock(Mutex);
+    C.Tasks.emplace_back(Request.begin(), Request.end());
+    WorkCV.notify_one();
+  }
+}
+
+void HMAgentWorkers::workerLoop() {
+  HMBatch Config;
+  HMResults Result;
+  HMResponseWriter Reply;
+  unique_lock<mutex> Lock(Mutex);
+  while (true) {
+    auto Next = Connections.end();
+    WorkCV.wait(Lock, [&] {
+      Next = find_if(Connections.begin(), Connections.end(),
+                     [](HMAgentConnection *C) { return !C->Tasks.empty(); });
+      return Stop || Next != Connections.end();
+    });
+    if (Next == Connections.end())
+      return;
+    // The coordinator takes its next turn after the others
+    HMAgentConnection &C = **Next;
+    Connections.splice(Connections.end(), Connections, Next);
+    vector<char> Task = move(C.Tasks.front());
+    C.Tasks.pop_front();
+    C.Running++;
+    Lock.unlock();
+
+    string_view Data(Task.data(), Task.size());
+    Config.resize(1, NumParams);
+    for (size_t p = 0; p < NumParams; p++)
+      Config.at(0, p) = readLEDouble(Data, (1 + p) * sizeof(uint64_t));
+    Result.reset(1, NumObjectives, NumMetrics);
+    uint64_t Status = StatusOk;
+    try {
+      HMObjective Obj(Result, 0);
+      Objective(HMConfig(Scenario.InParams, Config, 0), Obj);
+    } catch (const exception &E) {
+      cerr << "Evaluation failed: " << E.what() << endl;
+      Status = StatusError;
+    } catch (...) {
+      cerr << "Evaluation failed with an unknown exception" << endl;
+      Status = StatusError;
+    }
+    Reply.clear();
+    Reply.appendLE(readLE64(Data, 0));
+    Reply.appendLE(Status);
+    Reply.appendLE(uint64_t(Status == StatusOk && Result.feasible()[0]));
+    for (size_t out = 0; out < NumObjectives + NumMetrics; out++)
+      Reply.appendLE(Result.at(0, out));
+    {
+      lock_guard<mutex> SendLock(C.SendMutex);
+      sendAll(C.FD, Reply.data());
+    }
+
+    Lock.lock();
+    if (--C.Running == 0)
+      IdleCV.notify_all();
+  }
+}
+
+void runAgent(int Port, unsigned Slots, const HMScenario &Scenario,
+              const HMObjectiveFn &Objective) {
+  if (Slots == 0)
+    Slots = max(1u, thread::hardware_concurrency());
+  signal(SIGPIPE, SIG_IGN);
+  int Listener = socket(AF_INET6, SOCK_STREAM, 0);
+  if (Listener < 0)
+    fatalError(string("Unable to create socket: ") + strerror(errno));
+  int One = 1, Zero = 0;
+  setsockopt(Listener, SOL_SOCKET, SO_REUSEADDR, &One, sizeof(One));
+  setsockopt(Listener, IPPROTO_IPV6, IPV6_V6ONLY, &Zero, sizeof(Zero));
+  sockaddr_in6 Address;
+  memset(&Address, 0, sizeof(Address));
+  Address.sin6_family = AF_INET6;
+  Address.sin6_addr = in6addr_any;
+  Address.sin6_port = htons(Port);
+  if (bind(Listener, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) ||
+      listen(Listener, 4)) {
+    close(Listener);
+    fatalError("Unable to listen on port " + to_string(Port) + ": " +
+               strerror(errno));
+  }
+  cout << "Agent listening on port " << Port << " with " << Slots << " slots"
+       << endl;
+  HMAgentWorkers Workers(Slots, Scenario, Objective);
+  while (true) {
+    int FD = accept(Listener, nullptr, nullptr);
+    if (FD < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      close(Listener);
+      fatalError(string("Unable to accept connection: ") + strerror(errno));
+    }
+    setsockopt(FD, IPPROTO_TCP, TCP_NODELAY, &One, sizeof(One));
+    Workers.serve(FD);
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef HM_REMOTE_H
+#define HM_REMOTE_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hm_batch.h"
+#include "hm_log.h"
+#include "hm_process_pool.h"
+#include "hm_protocol.h"
+#include "hypermapper_client.h"
+
+// Distributed evaluation over TCP. The client acts as coordinator: it talks
+// to HyperMapper as usual and sends the configurations of each batch to
+// hm_agent processes on other machines.
+//
+// A connection starts with the line "HMAgent 1 <signature> <params>
+// <objectives> <metrics>" from the coordinator, answered by "Ready <slots>"
+// if the agent runs the same scenario or "Error <reason>". After that every
+// configuration is a frame of its task id and parameter values, and every
+// result a frame of the task id, a status, the feasibility and the outputs,
+// all little-endian 8 byte values.
+
+// Coordinator side: keeps up to twice its slot count of configurations in
+// flight on every agent and sends each new one to the agent with the
+// shortest queue relative to its slots. Configurations of an agent that
+// disconnects are sent again to the others.
+class HMRemotePool {
+public:
+  // Connects to every host:port in Agents and checks they run a scenario
+  // with this Signature and shape
+  HMRemotePool(const std::vector<std::string> &Agents, uint64_t Signature,
+               size_t NumParams, size_t NumObjectives, size_t NumMetrics,
+               HMLogLevel LogLevel);
+  ~HMRemotePool();
+
+  HMRemotePool(const HMRemotePool &) = delete;
+  HMRemotePool &operator=(const HMRemotePool &) = delete;
+
+  size_t getNumAgents() const { return Agents.size(); }
+  unsigned getNumSlots() const;
+
+  // Evaluates the rows Configs of Batch on the agents and stores their
+  // results in Results. Failed[Row] is set for rows whose objective threw.
+  // Completed is called with each row as soon as it is done.
+  void evaluate(const HMBatch &Batch, const std::vector<size_t> &Configs,
+                HMResults &Results, std::vector<uint8_t> &Failed,
+                const HMProcessPool::RowFn &Completed = nullptr);
+
+private:
+  struct Agent {
+    std::string Address;
+    int FD = -1;
+    unsigned Slots = 0;
+    std::unique_ptr<HMLineReader> Reader;
+    std::vector<size_t> InFlight;
+  };
+
+  void disconnect(Agent &A);
+
+  size_t NumParams;
+  size_t NumObjectives;
+  size_t NumMetrics;
+  HMLogLevel LogLevel;
+  std::vector<Agent> Agents;
+  HMResponseWriter Frame;
+};
+
+// Agent side: serves the coordinators connecting on Port, each from a
+// thread of its own, and evaluates their configurations with Objective on
+// Slots threads (0 = one per hardware thread) shared between them. Only
+// returns by throwing HMError.
+[[noreturn]] void runAgent(int Port, unsigned Slots,
+                           const HMScenario &Scenario,
+                           const HMObjectiveFn &Objective);
+
+#endif
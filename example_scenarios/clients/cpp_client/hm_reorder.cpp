@@ -0,0 +1,149 @@
+#include <utility>
+
+#include "hm_reorder.h"
+
+using namespace std;
+
+void HMReorderBuffer::reset(size_t NumRows, EmitFn _Emit, FlushFn _Flush) {
+  lock_guard<mutex> Lock(Mutex);
+  Ready.assign(NumRows, 0);
+  NextRow = 0;
+  Emitting = false;
+  Emit = move(_Emit);
+  Flush = move(_Flush);
+}
+
+void HMReorderBuffer::complete(size_t Row) {
+  unique_lock<mutex> Lock(Mutex);
+  Ready[Row] = 1;
+  // The thread already emitting picks this row up when it is next
+  if (Emitting)
+    return;
+  Emitting = true;
+  try {
+    while (true) {
+      size_t Emitted = 0;
+      while (NextRow < Ready.size() && Ready[NextRow]) {
+        size_t Next = NextRow++;
+        Lock.unlock();
+        Emit(Next);
+        Lock.lock();
+        Emitted++;
+      }
+      // Rows completed during the flush are emitted by the next round
+      if (!Emitted)
+        break;
+      Lock.unlock();
+      Flush();
+      Lock.lock();
+    }
+  } catch (...) {
+    if (!Lock.owns_lock())
+      Lock.lock();
+    Emitting = false;
+    throw;
+  }
+  Emitting = false;
+}
+
+size_t HMReorderBuffer::getNumEmitted() {
+  lock_guard<mutex> Lock(Mutex);
+  return NextRow;
+}
+
+HMReplyStream::HMReplyStream(chrono::steady_clock::duration _MaxDelay,
+                             size_t _MaxPending, HMLogLevel _LogLevel)
+    : MaxDelay(_MaxDelay), MaxPending(_MaxPending), LogLevel(_LogLevel) {}
+
+HMReplyStream::~HMReplyStream() {
+  {
+    lock_guard<mutex> Lock(Mutex);
+    Stop = true;
+  }
+  WriterCV.notify_one();
+  if (Writer.joinable())
+    Writer.join();
+}
+
+void HMReplyStream::start(int _FD, string_view Header) {
+  unique_lock<mutex> Lock(Mutex);
+  FD = _FD;
+  Pending.clear();
+  Pending.append(Header);
+  if (!Writer.joinable())
+    Writer = thread([this] { writerLoop(); });
+  writePending(Lock);
+}
+
+void HMReplyStream::flush() {
+  unique_lock<mutex> Lock(Mutex);
+  if (Pending.data().empty())
+    return;
+  if (!Busy && (Pending.data().size() >= MaxPending ||
+                chrono::steady_clock::now() >= LastWrite + MaxDelay)) {
+    writePending(Lock);
+  } else if (!Armed) {
+    Armed = true;
+    WriterCV.notify_one();
+  }
+}
+
+void HMReplyStream::finish() {
+  unique_lock<mutex> Lock(Mutex);
+  IdleCV.wait(Lock, [&] { return !Busy; });
+  writePending(Lock);
+  FD = -1;
+  Armed = false;
+  if (Error)
+    rethrow_exception(exchange(Error, nullptr));
+}
+
+// Writes Pending with Lock released meanwhile, so rows are appended during
+// the write. Nothing is written after a failed write.
+void HMReplyStream::writePending(unique_lock<mutex> &Lock) {
+  if (Pending.data().empty() || FD < 0)
+    return;
+  Busy = true;
+  Writing.swap(Pending);
+  int WriteFD = FD;
+  bool Failed = bool(Error);
+  Lock.unlock();
+  exception_ptr WriteError;
+  if (!Failed) {
+    try {
+      HM_LOG(LogLevel, HMLogTrace, "Response:\n" << Writing.data());
+      writeAll(WriteFD, Writing.data());
+    } catch (...) {
+      WriteError = current_exception();
+    }
+  }
+  Writing.clear();
+  Lock.lock();
+  Busy = false;
+  LastWrite = chrono::steady_clock::now();
+  if (WriteError)
+    Error = WriteError;
+  IdleCV.notify_all();
+}
+
+void HMReplyStream::writerLoop() {
+  unique_lock<mutex> Lock(Mutex);
+  while (!Stop) {
+    if (!Armed) {
+      WriterCV.wait(Lock);
+      continue;
+    }
+    // Rows appended during another thread's write are due a delay after it
+    if (Busy) {
+      IdleCV.wait(Lock, [this] { return !Busy; });
+      continue;
+    }
+    auto Due = LastWrite + MaxDelay;
+    if (chrono::steady_clock::now() < Due) {
+      WriterCV.wait_until(Lock, Due);
+      continue;
+    }
+    Armed = false;
+    writePending(Lock);
+  }
+}
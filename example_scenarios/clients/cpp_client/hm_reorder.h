@@ -0,0 +1,102 @@
+#ifndef HM_REORDER_H
+#define HM_REORDER_H
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hm_log.h"
+#include "hm_protocol.h"
+
+// Reorder buffer that turns results completing in any order, e.g. from the
+// evaluator threads, into an in-order stream. Every completed row is passed
+// to Emit as soon as it and all rows before it are complete, and Flush is
+// called whenever no further row can be emitted yet. Emit and Flush are
+// called by one thread at a time, whichever completed the row that
+// unblocked them, and never with the lock held, so a slow Flush does not
+// stop other threads from completing rows.
+class HMReorderBuffer {
+public:
+  using EmitFn = std::function<void(size_t Row)>;
+  using FlushFn = std::function<void()>;
+
+  // Starts a batch of NumRows rows. Must not race with complete().
+  void reset(size_t NumRows, EmitFn Emit, FlushFn Flush);
+
+  // Marks Row as complete and emits it and the rows after it, if they are
+  // next. Exceptions from Emit or Flush are passed to the caller.
+  void complete(size_t Row);
+
+  // Number of rows emitted so far
+  size_t getNumEmitted();
+
+private:
+  std::mutex Mutex;
+  std::vector<uint8_t> Ready;
+  size_t NextRow = 0;
+  bool Emitting = false;
+  EmitFn Emit;
+  FlushFn Flush;
+};
+
+// Reply streamed to a file descriptor as its rows are appended. Rows are
+// written together, once MaxDelay has passed since the previous write or
+// at once when MaxPending bytes are pending. flush() writes them from the
+// calling thread when they are due and otherwise leaves them to a writer
+// thread that wakes up at the deadline, so a row held back reaches the
+// reader within MaxDelay even when no further row completes meanwhile.
+class HMReplyStream {
+public:
+  HMReplyStream(std::chrono::steady_clock::duration MaxDelay,
+                size_t MaxPending, HMLogLevel LogLevel);
+  ~HMReplyStream();
+
+  HMReplyStream(const HMReplyStream &) = delete;
+  HMReplyStream &operator=(const HMReplyStream &) = delete;
+
+  // Starts a reply to FD by writing Header. Must not race with the other
+  // members.
+  void start(int FD, std::string_view Header);
+
+  // Appends to the reply with Append(HMResponseWriter &)
+  template <typename Fn> void append(Fn Append) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Append(Pending);
+  }
+
+  // Called once appended rows may be sent. Calls must not overlap.
+  void flush();
+
+  // Writes the rest of the reply. An error of any write of the reply is
+  // rethrown here.
+  void finish();
+
+private:
+  void writerLoop();
+  void writePending(std::unique_lock<std::mutex> &Lock);
+
+  std::chrono::steady_clock::duration MaxDelay;
+  size_t MaxPending;
+  HMLogLevel LogLevel;
+  std::mutex Mutex;
+  std::condition_variable WriterCV;
+  std::condition_variable IdleCV;
+  // Appended and not yet written, and being written
+  HMResponseWriter Pending, Writing;
+  int FD = -1;
+  // Whether the writer thread is to write Pending at the deadline
+  bool Armed = false;
+  // Whether a thread is writing without the lock
+  bool Busy = false;
+  bool Stop = false;
+  std::chrono::steady_clock::time_point LastWrite;
+  std::exception_ptr Error;
+  std::thread Writer;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "hypermapper_client.h"
+#include "json.hpp"
+
+using namespace std;
+
+// The JSON library is only used here, so the other translation units do not
+// pay for compiling it
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+// Scenario value of a number, integral values are written without a
+// fractional part
+static json toJSonNumber(double Value) {
+  if (Value == nearbyint(Value) && fabs(Value) < 1e15)
+    return json(int64_t(Value));
+  return json(Value);
+}
+
+// Function that creates the json scenario for hypermapper and returns the
+// path of the written file. The output folder is created if needed.
+string HyperMapperClient::createScenarioFile(const HMScenario &Scenario,
+                                             HMLogLevel LogLevel,
+                                             const string &ResumeDataFile) {
+  const string &AppName = Scenario.AppName;
+  const string &OutputFoldername = Scenario.OutputFoldername;
+
+  string CurrentDir = fs::current_path();
+  string OutputDir = CurrentDir + "/" + OutputFoldername + "/";
+  if (fs::exists(OutputDir)) {
+    if (LogLevel >= HMLogSummary)
+      cerr << "Output directory exists, continuing!" << endl;
+  } else {
+
+    if (LogLevel >= HMLogSummary)
+      cerr << "Output directory does not exist, creating!" << endl;
+    // Another study of this process may have created it meanwhile
+    if (!fs::create_directory(OutputDir) && !fs::is_directory(OutputDir)) {
+      fatalError("Unable to create Directory: " + OutputDir);
+    }
+  }
+  json HMScenario;
+  HMScenario["application_name"] = AppName;
+  HMScenario["optimization_objectives"] = json(Scenario.Objectives);
+  HMScenario["hypermapper_mode"]["mode"] = "client-server";
+  if (Scenario.FileProtocolBatchSize > 0)
+    HMScenario["hypermapper_mode"]["file_protocol_batch_size"] =
+        Scenario.FileProtocolBatchSize;
+  if (Scenario.BinaryProtocol)
+    HMScenario["hypermapper_mode"]["binary_protocol"] = true;
+  HMScenario["run_directory"] = CurrentDir;
+  HMScenario["log_file"] = OutputFoldername + "/log_" + AppName + ".log";
+  HMScenario["optimization_iterations"] = Scenario.NumIterations;
+  if (Scenario.EvaluationsPerIteration > 1)
+    HMScenario["evaluations_per_optimization_iteration"] =
+        Scenario.EvaluationsPerIteration;
+  HMScenario["number_of_cpus"] = Scenario.NumCPUs;
+  if (!ResumeDataFile.empty()) {
+    HMScenario["resume_optimization"] = true;
+    HMScenario["resume_optimization_data"] = ResumeDataFile;
+  }
+  HMScenario["models"]["model"] = "random_forest";
+
+  if (Scenario.Predictor) {
+    json HMFeasibleOutput;
+    HMFeasibleOutput["enable_feasible_predictor"] = true;
+    HMFeasibleOutput["false_value"] = "0";
+    HMFeasibleOutput["true_value"] = "1";
+    HMScenario["feasible_output"] = HMFeasibleOutput;
+  }
+
+  HMScenario["output_data_file"] =
+      OutputFoldername + "/" + AppName + "_output_data.csv";
+  HMScenario["output_pareto_file"] =
+      OutputFoldername + "/" + AppName + "_output_pareto.csv";
+  HMScenario["output_image"]["output_image_pdf_file"] =
+      OutputFoldername + "_" + AppName + "_output_image.pdf";
+
+  json HMDOE;
+  HMDOE["doe_type"] = "standard latin hypercube"; // "random sampling";
+  HMDOE["number_of_samples"] = Scenario.NumSamples;
+
+  HMScenario["design_of_experiment"] = HMDOE;
+
+  for (size_t i = 0; i < Scenario.InParams.size(); i++) {
+    const HMInputParam *InParam = Scenario.InParams[i];
+    json HMParam;
+    HMParam["parameter_type"] = getTypeAsString(InParam->getType());
+    const vector<double> &Range = InParam->getRange();
+    switch (InParam->getType()) {
+    case Real:
+    case Integer:
+      if (Range.size() != 2)
+        fatalError("Parameter " + InParam->getName() +
+                   " needs a range {min, max}");
+      HMParam["values"] = json::array();
+      for (double V : Range)
+        HMParam["values"].push_back(InParam->getType() == Real
+                                        ? json(V)
+                                        : toJSonNumber(V));
+      break;
+    case Ordinal:
+      HMParam["values"] = json::array();
+      for (double V : Range)
+        HMParam["values"].push_back(toJSonNumber(V));
+      break;
+    case Categorical:
+      if (InParam->getCategories().empty())
+        fatalError("Parameter " + InParam->getName() + " has no categories");
+      HMParam["values"] = json::array();
+      if (InParam->hasNumericCategories())
+        for (double V : Range)
+          HMParam["values"].push_back(toJSonNumber(V));
+      else
+        HMParam["values"] = json(InParam->getCategories());
+      break;
+    }
+    HMScenario["input_parameters"][getParamKey(i)] = HMParam;
+  }
+
+  //  cout << setw(4) << HMScenario << endl;
+  ofstream HyperMapperScenarioFile;
+
+  string JSonFileNameStr =
+      CurrentDir + "/" + OutputFoldername + "/" + AppName + "_scenario.json";
+
+  HyperMapperScenarioFile.open(JSonFileNameStr);
+  if (HyperMapperScenarioFile.fail()) {
+    fatalError("Unable to open file: " + JSonFileNameStr);
+  }
+  HM_LOG(LogLevel, HMLogSummary,
+         "Writing JSON file to: " << JSonFileNameStr << endl);
+  HyperMapperScenarioFile << setw(4) << HMScenario << endl;
+  return JSonFileNameStr;
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+
+#include "hm_scheduler.h"
+
+using namespace std;
+
+HMScheduler::HMScheduler(unsigned NumWorkers, HMPlacement _Placement)
+    : Placement(_Placement), Plan(planPlacement(Placement, NumWorkers)) {
+  // Callers only wait, so every evaluation runs on a worker and NumWorkers
+  // bounds them whatever the number of studies
+  for (size_t i = 0; i < Plan.Workers.size(); i++)
+    Threads.emplace_back(&HMScheduler::workerLoop, this, i);
+}
+
+HMScheduler::~HMScheduler() {
+  {
+    lock_guard<mutex> Lock(Mutex);
+    Stop = true;
+  }
+  WorkCV.notify_all();
+  for (auto &T : Threads)
+    T.join();
+}
+
+void HMScheduler::evaluate(size_t NumConfigs,
+                           const HMEvaluator::ObjectiveFn &Fn,
+                           unsigned Weight) {
+  run(NumConfigs, Fn, Weight, false);
+}
+
+void HMScheduler::evaluateBackground(size_t NumConfigs,
+                                     const HMEvaluator::ObjectiveFn &Fn) {
+  run(NumConfigs, Fn, 1, true);
+}
+
+void HMScheduler::run(size_t NumConfigs, const HMEvaluator::ObjectiveFn &Fn,
+                      unsigned Weight, bool Background) {
+  if (NumConfigs == 0)
+    return;
+  unique_lock<mutex> Lock(Mutex);
+  Batch B(Fn, NumConfigs, max(Weight, 1u), Background, NextSequence++);
+  Queued.push_back(&B);
+  WorkCV.notify_all();
+  B.Done.wait(Lock, [&] { return B.Next == B.NumTasks && B.Running == 0; });
+  if (B.Error)
+    rethrow_exception(B.Error);
+}
+
+// Returns the queued batch with the fewest evaluations in flight relative
+// to its weight, a background batch only if no other one is queued. Queued
+// is in arrival order, so ties go to the oldest.
+HMScheduler::Batch *HMScheduler::pickBatch() const {
+  Batch *Best = Queued.front();
+  for (Batch *B : Queued)
+    if (B->Background != Best->Background
+            ? Best->Background
+            : uint64_t(B->Running) * Best->Weight <
+                  uint64_t(Best->Running) * B->Weight)
+      Best = B;
+  return Best;
+}
+
+// Removes B from the queue once all its configurations are started
+void HMScheduler::retire(Batch *B) {
+  auto It = find(Queued.begin(), Queued.end(), B);
+  if (It != Queued.end())
+    Queued.erase(It);
+}
+
+void HMScheduler::workerLoop(size_t Worker) {
+  pinThread(Plan.Workers[Worker]);
+  unique_lock<mutex> Lock(Mutex);
+  while (true) {
+    WorkCV.wait(Lock, [this] { return Stop || !Queued.empty(); });
+    if (Stop)
+      return;
+    Batch *B = pickBatch();
+    size_t Task = B->Next++;
+    B->Running++;
+    if (B->Next == B->NumTasks)
+      retire(B);
+
+    Lock.unlock();
+    exception_ptr Error;
+    try {
+      (*B->Fn)(Task);
+    } catch (...) {
+      Error = current_exception();
+    }
+    Lock.lock();
+
+    B->Running--;
+    if (Error && !B->Error) {
+      B->Error = Error;
+      B->Next = B->NumTasks;
+      retire(B);
+    }
+    if (B->Next == B->NumTasks && B->Running == 0)
+      B->Done.notify_one();
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef HM_SCHEDULER_H
+#define HM_SCHEDULER_H
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hm_evaluator.h"
+
+// Thread pool shared by the studies of one process. Every study submits its
+// batches from its own thread and the pool runs at most NumWorkers
+// evaluations at a time in total, instead of each study running a pool of
+// its own and oversubscribing the machine.
+//
+// Scheduling is fair share: a free worker takes the next configuration of
+// the batch with the fewest evaluations in flight relative to its weight,
+// the oldest batch on ties. A batch that arrives while another one holds
+// every worker gets the next free one, and a study alone uses all of them.
+// Background batches, such as speculative evaluations, only get workers no
+// other queued batch has configurations for.
+class HMScheduler {
+public:
+  // NumWorkers is the total number of concurrent evaluations. 0 means one
+  // per available hardware thread, or with a Placement other than
+  // HMPlaceAny one per core left for the workers, see planPlacement.
+  explicit HMScheduler(unsigned NumWorkers = 0,
+                       HMPlacement Placement = HMPlaceAny);
+  ~HMScheduler();
+
+  HMScheduler(const HMScheduler &) = delete;
+  HMScheduler &operator=(const HMScheduler &) = delete;
+
+  unsigned getNumWorkers() const { return Threads.size(); }
+
+  HMPlacement getPlacement() const { return Placement; }
+  // CPUs the threads of the studies should run on, empty for any
+  const HMCPUSet &getProtocolCPUs() const { return Plan.Protocol; }
+
+  // Runs Fn(i) for every i below NumConfigs on the workers, with Weight
+  // times the share of a batch of weight 1. Blocks until the whole batch is
+  // done and can be called from several threads at once. If Fn throws, the
+  // rest of its batch is skipped and the first exception is rethrown here.
+  void evaluate(size_t NumConfigs, const HMEvaluator::ObjectiveFn &Fn,
+                unsigned Weight = 1);
+
+  // Like evaluate, as a background batch
+  void evaluateBackground(size_t NumConfigs,
+                          const HMEvaluator::ObjectiveFn &Fn);
+
+private:
+  struct Batch {
+    Batch(const HMEvaluator::ObjectiveFn &_Fn, size_t _NumTasks,
+          unsigned _Weight, bool _Background, uint64_t _Sequence)
+        : Fn(&_Fn), NumTasks(_NumTasks), Weight(_Weight),
+          Background(_Background), Sequence(_Sequence) {}
+
+    const HMEvaluator::ObjectiveFn *Fn;
+    size_t NumTasks;
+    unsigned Weight;
+    bool Background;
+    uint64_t Sequence;
+    size_t Next = 0;
+    unsigned Running = 0;
+    std::exception_ptr Error;
+    std::condition_variable Done;
+  };
+
+  void run(size_t NumConfigs, const HMEvaluator::ObjectiveFn &Fn,
+           unsigned Weight, bool Background);
+  void workerLoop(size_t Worker);
+  Batch *pickBatch() const;
+  void retire(Batch *B);
+
+  HMPlacement Placement;
+  HMPlacementPlan Plan;
+  std::vector<std::thread> Threads;
+  std::mutex Mutex;
+  std::condition_variable WorkCV;
+  // Batches with configurations not started yet
+  std::vector<Batch *> Queued;
+  uint64_t NextSequence = 0;
+  bool Stop = false;
+};
+
+#endif
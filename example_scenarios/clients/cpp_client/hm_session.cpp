@@ -0,0 +1,286 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "cpp_client.h"
+#include "hm_protocol.h"
+#include "hm_session.h"
+
+using namespace std;
+
+// Largest chunk read from a socket at once
+static constexpr size_t ReadSize = 256 << 10;
+
+// Stream of one study. A socket pair whose other end the session's I/O
+// thread forwards to and from HyperMapper, so the protocol loop runs on it
+// unchanged. The session must outlive it.
+class HMSessionTransport : public HMTransport {
+public:
+  HMSessionTransport(HMSession &_Session, uint64_t _Id, int FD)
+      : Session(_Session), Id(_Id) {
+    ReadFD = WriteFD = FD;
+    Description = "session study " + to_string(Id);
+  }
+
+  ~HMSessionTransport() override { close(true); }
+
+  void close(bool Abort) override {
+    if (ReadFD < 0)
+      return;
+    if (Abort) {
+      Session.killStudy(Id);
+    } else {
+      // Wait for the study's process to exit, as for a spawned HyperMapper
+      shutdown(ReadFD, SHUT_WR);
+      char Discard[4096];
+      ssize_t Read;
+      while ((Read = read(ReadFD, Discard, sizeof(Discard))) > 0 ||
+             (Read < 0 && errno == EINTR))
+        ;
+    }
+    HMTransport::close();
+  }
+
+private:
+  HMSession &Session;
+  uint64_t Id;
+};
+
+HMSession::HMSession(const string &Address, double RetrySeconds,
+                     HMLogLevel _LogLevel)
+    : LogLevel(_LogLevel) {
+  HM_LOG(LogLevel, HMLogSummary,
+         "Connecting to HyperMapper session at " << Address << endl);
+  Conn = connectSocket(Address, RetrySeconds);
+
+  // Handshake, read a byte at a time so nothing after it is consumed
+  constexpr string_view Hello = "HMSession 1\n";
+  string Reply;
+  char C;
+  bool Sent = send(Conn, Hello.data(), Hello.size(), MSG_NOSIGNAL) ==
+              ssize_t(Hello.size());
+  while (Sent && read(Conn, &C, 1) == 1 && C != '\n')
+    Reply += C;
+  if (Reply != "Ready") {
+    close(Conn);
+    fatalError("HyperMapper at " + Address + " refused the session" +
+               (Reply.empty() ? string() : ": " + Reply));
+  }
+
+  fcntl(Conn, F_SETFL, fcntl(Conn, F_GETFL) | O_NONBLOCK);
+  WakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (WakeFD < 0) {
+    close(Conn);
+    fatalError(string("Unable to create eventfd: ") + strerror(errno));
+  }
+  IOThread = thread(&HMSession::serve, this);
+}
+
+HMSession::~HMSession() {
+  {
+    lock_guard<mutex> Guard(Lock);
+    Stopping = true;
+  }
+  wake();
+  IOThread.join();
+  for (auto &Entry : Studies)
+    close(Entry.second.FD);
+  close(Conn);
+  close(WakeFD);
+}
+
+unique_ptr<HMTransport> HMSession::openStudy(const string &ScenarioPath) {
+  int Pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, Pair))
+    fatalError(string("Unable to create socket pair: ") + strerror(errno));
+  fcntl(Pair[1], F_SETFL, fcntl(Pair[1], F_GETFL) | O_NONBLOCK);
+
+  uint64_t Id;
+  {
+    lock_guard<mutex> Guard(Lock);
+    if (!Error.empty()) {
+      close(Pair[0]);
+      close(Pair[1]);
+      fatalError("HyperMapper session lost: " + Error);
+    }
+    Id = NextId++;
+    Studies[Id].FD = Pair[1];
+    ToServer += "Open " + to_string(Id) + " " + ScenarioPath + "\n";
+  }
+  wake();
+  HM_LOG(LogLevel, HMLogSummary,
+         "Started session study " << Id << " of " << ScenarioPath << endl);
+  return unique_ptr<HMTransport>(new HMSessionTransport(*this, Id, Pair[0]));
+}
+
+void HMSession::killStudy(uint64_t Id) {
+  {
+    lock_guard<mutex> Guard(Lock);
+    auto It = Studies.find(Id);
+    if (It == Studies.end() || It->second.Exited)
+      return;
+    ToServer += "Kill " + to_string(Id) + "\n";
+  }
+  wake();
+}
+
+void HMSession::wake() {
+  uint64_t One = 1;
+  (void)!write(WakeFD, &One, sizeof(One));
+}
+
+// Marks the connection lost. The studies read end of file once their
+// pending data is written.
+void HMSession::fail(const string &Reason) {
+  Error = Reason;
+  ToServer.clear();
+  for (auto &Entry : Studies)
+    Entry.second.Exited = true;
+  HM_LOG(LogLevel, HMLogSummary, "HyperMapper session lost: " << Reason
+                                                              << endl);
+}
+
+void HMSession::readServer() {
+  size_t Size = FromServer.size();
+  FromServer.resize(Size + ReadSize);
+  ssize_t Read = read(Conn, &FromServer[Size], ReadSize);
+  FromServer.resize(Size + max<ssize_t>(Read, 0));
+  if (Read == 0)
+    fail("connection closed by HyperMapper");
+  else if (Read < 0 && errno != EAGAIN && errno != EINTR)
+    fail(strerror(errno));
+  else
+    parseMessages();
+}
+
+// Hands the complete messages of FromServer to their studies
+void HMSession::parseMessages() {
+  size_t Pos = 0, Newline;
+  while ((Newline = FromServer.find('\n', Pos)) != string::npos) {
+    string_view Header(&FromServer[Pos], Newline - Pos);
+    size_t Space1 = Header.find(' ');
+    size_t Space2 = Header.find(' ', Space1 + 1);
+    string_view Kind = Header.substr(0, Space1);
+    uint64_t Id;
+    int64_t Value;
+    if (Space1 == string_view::npos || Space2 == string_view::npos ||
+        !parseField(Header.substr(Space1 + 1, Space2 - Space1 - 1), Id) ||
+        !parseField(Header.substr(Space2 + 1), Value) ||
+        (Kind != "Data" && Kind != "Exit")) {
+      fail("unexpected message: " + string(Header));
+      return;
+    }
+    auto It = Studies.find(Id);
+    if (Kind == "Data") {
+      if (FromServer.size() - Newline - 1 < uint64_t(Value))
+        break;
+      if (It != Studies.end() && !It->second.Closed)
+        It->second.Pending.append(FromServer, Newline + 1, Value);
+      Pos = Newline + 1 + Value;
+    } else {
+      if (It != Studies.end())
+        It->second.Exited = true;
+      if (Value)
+        HM_LOG(LogLevel, HMLogSummary,
+               "Session study " << Id << " exited with status " << Value
+                                << endl);
+      Pos = Newline + 1;
+    }
+  }
+  FromServer.erase(0, Pos);
+}
+
+void HMSession::flushServer() {
+  ssize_t Sent = send(Conn, ToServer.data(), ToServer.size(),
+                      MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (Sent > 0)
+    ToServer.erase(0, Sent);
+  else if (Sent < 0 && errno != EAGAIN && errno != EINTR)
+    fail(strerror(errno));
+}
+
+// Moves data between the study Id and the connection given the poll
+// Events of its socket, and forgets it once both sides are done
+void HMSession::forwardStudy(uint64_t Id, short Events) {
+  auto It = Studies.find(Id);
+  Study &S = It->second;
+  if (Events & POLLOUT) {
+    ssize_t Sent = send(S.FD, S.Pending.data(), S.Pending.size(),
+                        MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (Sent > 0)
+      S.Pending.erase(0, Sent);
+    else if (Sent < 0 && errno != EAGAIN && errno != EINTR)
+      S.Pending.clear();
+  }
+  if ((Events & (POLLIN | POLLHUP | POLLERR)) && !S.Closed) {
+    char Buffer[64 << 10];
+    ssize_t Read = read(S.FD, Buffer, sizeof(Buffer));
+    if (Read > 0 && Error.empty()) {
+      ToServer += "Data " + to_string(Id) + " " + to_string(Read) + "\n";
+      ToServer.append(Buffer, Read);
+    } else if (Read == 0 || (Read < 0 && errno != EAGAIN && errno != EINTR)) {
+      S.Closed = true;
+      S.Pending.clear();
+      if (Error.empty() && !S.Exited)
+        ToServer += "Close " + to_string(Id) + "\n";
+    }
+  }
+  if (S.Exited && S.Pending.empty() && !S.ShutDown) {
+    shutdown(S.FD, SHUT_WR);
+    S.ShutDown = true;
+  }
+  if (S.Exited && S.Closed && S.Pending.empty()) {
+    close(S.FD);
+    Studies.erase(It);
+  }
+}
+
+// I/O thread: forwards between the connection and the studies' sockets
+// without blocking on either, so a study that does not read cannot stall
+// the others
+void HMSession::serve() {
+  vector<pollfd> FDs;
+  vector<uint64_t> Ids;
+  unique_lock<mutex> Guard(Lock);
+  while (!Stopping) {
+    FDs.assign({{WakeFD, POLLIN, 0}});
+    if (Error.empty())
+      FDs.push_back(
+          {Conn, short(POLLIN | (ToServer.empty() ? 0 : POLLOUT)), 0});
+    Ids.clear();
+    for (auto &Entry : Studies) {
+      Study &S = Entry.second;
+      // A closed study only waits for its Exit, poll would report its hang
+      // up again and again
+      FDs.push_back({S.Closed ? -1 : S.FD,
+                     short(POLLIN | (S.Pending.empty() ? 0 : POLLOUT)), 0});
+      Ids.push_back(Entry.first);
+    }
+
+    Guard.unlock();
+    int Ready = poll(FDs.data(), FDs.size(), -1);
+    Guard.lock();
+    if (Ready < 0)
+      continue;
+
+    if (FDs[0].revents) {
+      uint64_t Count;
+      (void)!read(WakeFD, &Count, sizeof(Count));
+    }
+    size_t First = 1;
+    if (FDs.size() > 1 && FDs[1].fd == Conn) {
+      First = 2;
+      if (FDs[1].revents & (POLLIN | POLLHUP | POLLERR))
+        readServer();
+    }
+    for (size_t I = 0; I < Ids.size(); I++)
+      forwardStudy(Ids[I], FDs[First + I].revents);
+    if (Error.empty() && !ToServer.empty())
+      flushServer();
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef HM_SESSION_H
+#define HM_SESSION_H
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "hm_log.h"
+#include "hm_transport.h"
+
+// Connection to a long-lived HyperMapper started with --session, which
+// imports its modules once and runs every study in a process forked from
+// itself. Studies of any number of threads share the connection.
+//
+// After the "HMSession 1" / "Ready" handshake, every message is a line
+// naming a study, optionally followed by a payload:
+//   client: Open <id> <scenario file>, Data <id> <size>, Close <id>,
+//           Kill <id>
+//   server: Data <id> <size>, Exit <id> <status>
+// Data carries the bytes of the study's usual protocol stream.
+class HMSession {
+public:
+  // Connects to the session listening on Address (see connectSocket)
+  HMSession(const std::string &Address, double RetrySeconds,
+            HMLogLevel LogLevel);
+  // Ends the session, HyperMapper terminates the studies still running
+  ~HMSession();
+
+  HMSession(const HMSession &) = delete;
+  HMSession &operator=(const HMSession &) = delete;
+
+  // Starts a study of the scenario file at ScenarioPath and returns the
+  // stream to run the protocol over. Can be called from any thread.
+  std::unique_ptr<HMTransport> openStudy(const std::string &ScenarioPath);
+
+private:
+  friend class HMSessionTransport;
+
+  struct Study {
+    // Session end of the socket pair given to the study
+    int FD = -1;
+    // Data received for the study and not written to FD yet
+    std::string Pending;
+    // The study closed its end for writing
+    bool Closed = false;
+    // HyperMapper reported the study's process exited
+    bool Exited = false;
+    // FD was shut down for writing after Exited, the study reads EOF
+    bool ShutDown = false;
+  };
+
+  void killStudy(uint64_t Id);
+  void wake();
+  void serve();
+  void readServer();
+  void parseMessages();
+  void flushServer();
+  void forwardStudy(uint64_t Id, short Events);
+  void fail(const std::string &Reason);
+
+  int Conn;
+  int WakeFD;
+  HMLogLevel LogLevel;
+  std::thread IOThread;
+
+  // Guards everything below, shared between openStudy and the I/O thread
+  std::mutex Lock;
+  std::map<uint64_t, Study> Studies;
+  uint64_t NextId = 1;
+  std::string ToServer;
+  std::string FromServer;
+  bool Stopping = false;
+  // Set once the connection is lost, with the reason
+  std::string Error;
+};
+
+#endif
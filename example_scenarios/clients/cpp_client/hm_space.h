@@ -0,0 +1,231 @@
+#ifndef HM_SPACE_H
+#define HM_SPACE_H
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "hm_protocol.h"
+#include "hypermapper_client.h"
+
+// Parameter spaces declared at compile time. A space is a tuple of typed
+// parameter descriptors, all literal types, so it can be constexpr:
+//
+//   constexpr auto Space = makeSpace(makeInteger("tile", 1, 64),
+//                                    makeReal("alpha", 0, 1),
+//                                    makeCategorical("order", "ijk", "kij"));
+//
+// describe() fills in the parameters of a scenario from the declaration,
+// and with them its scenario file section. Request rows of the scenario
+// are then parsed with a parser generated for the types of the space, and
+// wrap() hands the objective a std::tuple of the parameter values, one
+// typed element per parameter in declaration order.
+
+// Real parameter in [Min, Max]
+struct HMRealParam {
+  using Value = double;
+  const char *Name;
+  double Min, Max;
+
+  HMInputParam toInputParam() const {
+    HMInputParam Param(Name, ParamType::Real);
+    Param.setRange({Min, Max});
+    return Param;
+  }
+  bool parse(std::string_view Field, double &Stored) const {
+    return parseField(Field, Stored);
+  }
+  static Value decode(double Stored) { return Stored; }
+};
+
+// Integer parameter in [Min, Max]
+struct HMIntegerParam {
+  using Value = int;
+  const char *Name;
+  int Min, Max;
+
+  HMInputParam toInputParam() const {
+    HMInputParam Param(Name, ParamType::Integer);
+    Param.setRange(std::vector<int>{Min, Max});
+    return Param;
+  }
+  // HyperMapper may write integers with a fractional part
+  bool parse(std::string_view Field, double &Stored) const {
+    int Value;
+    if (parseField(Field, Value)) {
+      Stored = Value;
+      return true;
+    }
+    return parseField(Field, Stored);
+  }
+  static Value decode(double Stored) { return std::lround(Stored); }
+};
+
+// Ordinal parameter taking one of N values
+template <size_t N> struct HMOrdinalParam {
+  static_assert(N > 0, "Ordinal parameters need at least one value");
+  using Value = double;
+  const char *Name;
+  std::array<double, N> Values;
+
+  HMInputParam toInputParam() const {
+    HMInputParam Param(Name, ParamType::Ordinal);
+    Param.setRange(std::vector<double>(Values.begin(), Values.end()));
+    return Param;
+  }
+  bool parse(std::string_view Field, double &Stored) const {
+    return parseField(Field, Stored);
+  }
+  static Value decode(double Stored) { return Stored; }
+};
+
+// Categorical parameter with N named categories. Its value is the index of
+// the category.
+template <size_t N> struct HMCategoricalParam {
+  static_assert(N > 0, "Categorical parameters need at least one category");
+  using Value = size_t;
+  const char *Name;
+  std::array<std::string_view, N> Categories;
+
+  HMInputParam toInputParam() const {
+    HMInputParam Param(Name, ParamType::Categorical);
+    Param.setCategories(
+        std::vector<std::string>(Categories.begin(), Categories.end()));
+    return Param;
+  }
+  // A linear scan, the categories of a parameter are few
+  bool parse(std::string_view Field, double &Stored) const {
+    for (size_t c = 0; c < N; c++)
+      if (Categories[c] == Field) {
+        Stored = c;
+        return true;
+      }
+    return false;
+  }
+  static Value decode(double Stored) { return size_t(Stored); }
+};
+
+constexpr HMRealParam makeReal(const char *Name, double Min, double Max) {
+  return {Name, Min, Max};
+}
+
+constexpr HMIntegerParam makeInteger(const char *Name, int Min, int Max) {
+  return {Name, Min, Max};
+}
+
+template <typename... Values>
+constexpr HMOrdinalParam<sizeof...(Values)> makeOrdinal(const char *Name,
+                                                       Values... Vals) {
+  return {Name, {double(Vals)...}};
+}
+
+template <typename... Names>
+constexpr HMCategoricalParam<sizeof...(Names)>
+makeCategorical(const char *Name, Names... Categories) {
+  return {Name, {std::string_view(Categories)...}};
+}
+
+template <typename... Params> class HMSpace {
+private:
+  std::tuple<Params...> Descriptors;
+
+  using Indices = std::index_sequence_for<Params...>;
+
+  template <size_t... I>
+  bool parseFields(const std::array<std::string_view, sizeof...(Params)> &F,
+                   HMBatch &Batch, size_t Row,
+                   std::index_sequence<I...>) const {
+    return (std::get<I>(Descriptors).parse(F[I], Batch.at(Row, I)) && ...);
+  }
+
+  template <size_t... I>
+  auto decode(const HMConfig &C, std::index_sequence<I...>) const {
+    return std::make_tuple(std::get<I>(Descriptors).decode(C.getValue(I))...);
+  }
+
+  template <size_t... I>
+  std::vector<HMInputParam> toInputParams(std::index_sequence<I...>) const {
+    return {std::get<I>(Descriptors).toInputParam()...};
+  }
+
+public:
+  // Values of a configuration, in declaration order
+  using Config = std::tuple<typename Params::Value...>;
+
+  static constexpr size_t size() { return sizeof...(Params); }
+
+  constexpr explicit HMSpace(Params... _Descriptors)
+      : Descriptors(_Descriptors...) {}
+
+  template <size_t I> constexpr const auto &get() const {
+    return std::get<I>(Descriptors);
+  }
+
+  // Replaces the input parameters of Scenario with the parameters of the
+  // space. The scenario and its copies own them.
+  void describe(HMScenario &Scenario) const;
+
+  // Typed values of the configuration C of a scenario described by the
+  // space
+  Config decode(const HMConfig &C) const { return decode(C, Indices()); }
+
+  // Objective of a scenario described by the space, which calls
+  // F(const Config &, HMObjective &)
+  template <typename Fn> HMObjectiveFn wrap(Fn F) const {
+    return [Space = *this, F](const HMConfig &C, HMObjective &Obj) {
+      F(Space.decode(C), Obj);
+    };
+  }
+
+  // Parses the request row Line, whose columns map to parameters through
+  // Columns, into row Row of Batch. Each field is parsed by the descriptor
+  // of its parameter, so no field tests the parameter type.
+  bool parseRow(std::string_view Line, const HMHeaderMap &Columns,
+                HMBatch &Batch, size_t Row) const {
+    std::array<std::string_view, sizeof...(Params)> Fields;
+    HMLineTokenizer Tokenizer(Line);
+    for (size_t Column = 0; Column < size(); Column++)
+      if (!Tokenizer.next(Fields[Columns[Column]]))
+        return false;
+    return parseFields(Fields, Batch, Row, Indices());
+  }
+
+  template <typename Space> friend class HMSpaceParams;
+};
+
+template <typename... Params>
+constexpr HMSpace<Params...> makeSpace(Params... Descriptors) {
+  return HMSpace<Params...>(Descriptors...);
+}
+
+// The parameters of a space as HMTypedParams of a scenario
+template <typename Space> class HMSpaceParams : public HMTypedParams {
+private:
+  Space Desc;
+
+public:
+  explicit HMSpaceParams(const Space &_Desc) : Desc(_Desc) {
+    Params = Desc.toInputParams(typename Space::Indices());
+  }
+
+  bool parseRow(std::string_view Line, const HMHeaderMap &Columns,
+                HMBatch &Batch, size_t Row) const override {
+    return Desc.parseRow(Line, Columns, Batch, Row);
+  }
+};
+
+template <typename... Params>
+void HMSpace<Params...>::describe(HMScenario &Scenario) const {
+  auto Typed = std::make_shared<HMSpaceParams<HMSpace>>(*this);
+  Scenario.InParams.clear();
+  for (size_t i = 0; i < Typed->size(); i++)
+    Scenario.InParams.push_back(&(*Typed)[i]);
+  Scenario.TypedParams = std::move(Typed);
+}
+
+#endif
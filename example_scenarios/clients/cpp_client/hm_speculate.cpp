@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cmath>
+
+#include "hm_pareto.h"
+#include "hm_speculate.h"
+
+using namespace std;
+
+// Values on each side of the current one tried for an ordinal or integer
+// parameter, as with local_search.py's four numeric neighbours
+static constexpr size_t NeighborRadius = 2;
+
+// Bounds [Begin, End) of the values tried around Index among NumValues,
+// shifted to stay in range
+static pair<size_t, size_t> neighborWindow(size_t NumValues, size_t Index) {
+  constexpr size_t Width = 2 * NeighborRadius + 1;
+  if (NumValues <= Width)
+    return {0, NumValues};
+  size_t Begin = Index < NeighborRadius ? 0 : Index - NeighborRadius;
+  Begin = min(Begin, NumValues - Width);
+  return {Begin, Begin + Width};
+}
+
+HMSpeculator::HMSpeculator(const vector<HMInputParam *> &_Params,
+                           size_t _NumObjectives, size_t _NumMetrics,
+                           size_t _Limit, const HMObjectiveFn &_Objective)
+    : Params(_Params), NumParams(_Params.size()),
+      NumObjectives(_NumObjectives), NumMetrics(_NumMetrics), Limit(_Limit),
+      Objective(_Objective) {}
+
+HMSpeculator::~HMSpeculator() {
+  cancel();
+  if (Thread.joinable())
+    Thread.join();
+}
+
+void HMSpeculator::addSamples(const HMBatch &Batch, const HMResults &Results,
+                              const vector<uint8_t> &Failed) {
+  for (size_t Row = 0; Row < Batch.size(); Row++) {
+    if (Failed[Row] || !Results.feasible()[Row])
+      continue;
+    for (size_t Param = 0; Param < NumParams; Param++)
+      Samples.push_back(Batch.get(Row, Param) + 0.0); // No -0.0
+    for (size_t Obj = 0; Obj < NumObjectives; Obj++)
+      Costs.push_back(Results.objective(Obj)[Row]);
+  }
+}
+
+// Appends the neighbours of Config that are neither in Seen nor in Cache
+// to Neighbors, up to Limit
+void HMSpeculator::addNeighbors(const double *Config,
+                                const HMEvalCache &Cache,
+                                set<vector<double>> &Seen,
+                                vector<vector<double>> &Neighbors) const {
+  vector<double> Neighbor(Config, Config + NumParams);
+  auto tryValue = [&](size_t Param, double Value) {
+    if (Value == Config[Param] || Neighbors.size() >= Limit)
+      return;
+    Neighbor[Param] = Value + 0.0;
+    if (Seen.insert(Neighbor).second && !Cache.find(Neighbor.data()))
+      Neighbors.push_back(Neighbor);
+  };
+  for (size_t Param = 0; Param < NumParams; Param++) {
+    const HMInputParam &P = *Params[Param];
+    const vector<double> &Range = P.getRange();
+    switch (P.getType()) {
+    case Real:
+      break;
+    case Integer: {
+      size_t NumValues = size_t(Range[1] - Range[0]) + 1;
+      auto Window = neighborWindow(NumValues, size_t(Config[Param] - Range[0]));
+      for (size_t I = Window.first; I < Window.second; I++)
+        tryValue(Param, Range[0] + double(I));
+      break;
+    }
+    case Ordinal: {
+      auto It = find(Range.begin(), Range.end(), Config[Param]);
+      if (It == Range.end())
+        break;
+      auto Window = neighborWindow(Range.size(), It - Range.begin());
+      for (size_t I = Window.first; I < Window.second; I++)
+        tryValue(Param, Range[I]);
+      break;
+    }
+    case Categorical:
+      for (size_t I = 0; I < P.getCategories().size(); I++)
+        tryValue(Param, double(I));
+      break;
+    }
+    Neighbor[Param] = Config[Param];
+  }
+}
+
+void HMSpeculator::start(HMEvalCache &Cache, const RunFn &Run) {
+  collect(Cache);
+  if (Samples.empty() || Thread.joinable())
+    return;
+  // Neighbours of the most recent optimal samples first
+  vector<size_t> Front = computeParetoFront(Costs, NumObjectives);
+  set<vector<double>> Seen;
+  vector<vector<double>> Neighbors;
+  for (auto It = Front.rbegin();
+       It != Front.rend() && Neighbors.size() < Limit; ++It)
+    addNeighbors(&Samples[*It * NumParams], Cache, Seen, Neighbors);
+  if (Neighbors.empty())
+    return;
+
+  Candidates.resize(Neighbors.size(), NumParams);
+  CandidateRows.clear();
+  for (size_t Row = 0; Row < Neighbors.size(); Row++) {
+    for (size_t Param = 0; Param < NumParams; Param++)
+      Candidates.at(Row, Param) = Neighbors[Row][Param];
+    CandidateRows.emplace(Neighbors[Row], Row);
+  }
+  CandidateResults.reset(Neighbors.size(), NumObjectives, NumMetrics);
+  Collected.assign(Neighbors.size(), 0);
+  Awaited.assign(Neighbors.size(), 0);
+  {
+    lock_guard<mutex> Lock(Mutex);
+    State.assign(Neighbors.size(), Queued);
+    NumUnsettled = Neighbors.size();
+    Cancel = false;
+  }
+  Thread = thread([this, Run] {
+    HMEvaluator::ObjectiveFn Fn = [this](size_t Row) {
+      {
+        lock_guard<mutex> Lock(Mutex);
+        if (Cancel) {
+          State[Row] = Dropped;
+          NumUnsettled--;
+          SettledCV.notify_all();
+          return;
+        }
+        State[Row] = Running;
+      }
+      bool Evaluated = true;
+      HMObjective Obj(CandidateResults, Row);
+      try {
+        Objective(HMConfig(Params, Candidates, Row), Obj);
+      } catch (...) {
+        // Evaluated again if HyperMapper asks for it
+        Evaluated = false;
+      }
+      lock_guard<mutex> Lock(Mutex);
+      State[Row] = Evaluated ? Finished : Dropped;
+      NumUnsettled--;
+      SettledCV.notify_all();
+    };
+    Run(Candidates.size(), Fn);
+  });
+}
+
+void HMSpeculator::cancel() {
+  lock_guard<mutex> Lock(Mutex);
+  Cancel = true;
+}
+
+size_t HMSpeculator::collect(HMEvalCache &Cache) {
+  if (!Thread.joinable())
+    return 0;
+  vector<uint8_t> Settled;
+  bool AllSettled;
+  {
+    lock_guard<mutex> Lock(Mutex);
+    Settled = State;
+    AllSettled = NumUnsettled == 0;
+  }
+  size_t NumOutputs = NumObjectives + NumMetrics;
+  vector<double> Key(NumParams), Outputs(NumOutputs);
+  size_t Added = 0;
+  for (size_t Row = 0; Row < Candidates.size(); Row++) {
+    if (Settled[Row] != Finished || Collected[Row])
+      continue;
+    for (size_t Param = 0; Param < NumParams; Param++)
+      Key[Param] = Candidates.get(Row, Param);
+    for (size_t Out = 0; Out < NumOutputs; Out++)
+      Outputs[Out] = CandidateResults.at(Row, Out);
+    Cache.insert(Key.data(), Outputs.data(), CandidateResults.feasible()[Row]);
+    // Awaited results are counted by await
+    if (!Awaited[Row]) {
+      Unclaimed.insert(Key);
+      NumEvaluated++;
+    }
+    Collected[Row] = 1;
+    Added++;
+  }
+  if (Added)
+    Cache.flush();
+  // Every candidate has returned, so the batch of the thread is done
+  if (AllSettled)
+    Thread.join();
+  return Added;
+}
+
+bool HMSpeculator::isPending(const double *Key) const {
+  auto It = CandidateRows.find(vector<double>(Key, Key + NumParams));
+  if (It == CandidateRows.end() || Collected[It->second])
+    return false;
+  lock_guard<mutex> Lock(Mutex);
+  return State[It->second] == Running || State[It->second] == Finished;
+}
+
+bool HMSpeculator::await(const double *Key, HMResults &Results, size_t Row) {
+  size_t Candidate =
+      CandidateRows.at(vector<double>(Key, Key + NumParams));
+  {
+    unique_lock<mutex> Lock(Mutex);
+    SettledCV.wait(Lock, [&] {
+      return State[Candidate] == Finished || State[Candidate] == Dropped;
+    });
+    if (State[Candidate] == Dropped)
+      return false;
+  }
+  for (size_t Out = 0; Out < NumObjectives + NumMetrics; Out++)
+    Results.at(Row, Out) = CandidateResults.at(Candidate, Out);
+  Results.feasibleAt(Row) = CandidateResults.feasible()[Candidate];
+  Awaited[Candidate] = 1;
+  NumEvaluated++;
+  NumHits++;
+  return true;
+}
+
+bool HMSpeculator::claim(const double *Key) {
+  if (!Unclaimed.erase(vector<double>(Key, Key + NumParams)))
+    return false;
+  NumHits++;
+  return true;
+}
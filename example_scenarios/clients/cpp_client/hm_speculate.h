@@ -0,0 +1,125 @@
+#ifndef HM_SPECULATE_H
+#define HM_SPECULATE_H
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "hm_batch.h"
+#include "hm_cache.h"
+#include "hm_evaluator.h"
+#include "hypermapper_client.h"
+
+// Speculative evaluation while HyperMapper fits its model between batches.
+// The workers evaluate neighbours of the best configurations so far and
+// store them in the evaluation cache, so that configurations of the next
+// batch close to them are answered right away.
+//
+// Neighbours follow local_search.py's get_neighbors: one parameter changes
+// at a time, to every category of a categorical parameter and to the five
+// values around the current one of an ordinal or integer parameter. Real
+// parameters are not varied, as HyperMapper would hardly ask for the same
+// value again.
+//
+// The next request never waits for speculative work: cancel() only keeps
+// further neighbours from starting, and the evaluations in flight finish
+// on their workers alongside the batch. Their results reach the cache with
+// collect() once they are done. A requested configuration still being
+// evaluated speculatively is waited for with await() instead of being
+// evaluated twice.
+class HMSpeculator {
+public:
+  // Runs Fn(i) for every i below NumConfigs on the workers the batches
+  // leave idle and blocks
+  using RunFn = std::function<void(size_t NumConfigs,
+                                   const HMEvaluator::ObjectiveFn &Fn)>;
+
+  // Evaluates up to Limit neighbours per idle window with Objective
+  HMSpeculator(const std::vector<HMInputParam *> &Params,
+               size_t NumObjectives, size_t NumMetrics, size_t Limit,
+               const HMObjectiveFn &Objective);
+  // Cancels the evaluations not started and waits for the ones in flight,
+  // their results are dropped
+  ~HMSpeculator();
+
+  HMSpeculator(const HMSpeculator &) = delete;
+  HMSpeculator &operator=(const HMSpeculator &) = delete;
+
+  // Records the feasible, successfully evaluated rows of a batch
+  void addSamples(const HMBatch &Batch, const HMResults &Results,
+                  const std::vector<uint8_t> &Failed);
+
+  // Collects the finished evaluations into Cache and starts evaluating,
+  // with Run from another thread, neighbours of the Pareto-optimal samples
+  // that are not in Cache yet. Starts nothing while evaluations of the
+  // previous window are still in flight.
+  void start(HMEvalCache &Cache, const RunFn &Run);
+
+  // Starts no more evaluations. The ones in flight go on.
+  void cancel();
+
+  // Adds the evaluations finished since the last call to Cache. Returns how
+  // many were added.
+  size_t collect(HMEvalCache &Cache);
+
+  // Whether Key is being evaluated, or was evaluated since the last
+  // collect(), after cancel()
+  bool isPending(const double *Key) const;
+
+  // Waits for the evaluation of a pending Key and stores its outputs in row
+  // Row of Results, counting it as a hit. Returns false if it failed.
+  bool await(const double *Key, HMResults &Results, size_t Row);
+
+  // Whether Key is a speculative result not requested before, counting it
+  // as a hit
+  bool claim(const double *Key);
+
+  size_t getNumEvaluated() const { return NumEvaluated; }
+  size_t getNumHits() const { return NumHits; }
+
+private:
+  void addNeighbors(const double *Config, const HMEvalCache &Cache,
+                    std::set<std::vector<double>> &Seen,
+                    std::vector<std::vector<double>> &Neighbors) const;
+
+  const std::vector<HMInputParam *> &Params;
+  size_t NumParams;
+  size_t NumObjectives;
+  size_t NumMetrics;
+  size_t Limit;
+  const HMObjectiveFn &Objective;
+
+  // Feasible samples so far, row-major parameter values and objectives
+  std::vector<double> Samples;
+  std::vector<double> Costs;
+
+  enum CandidateState : uint8_t { Queued, Running, Finished, Dropped };
+
+  // Configurations of the window and their results. A result is only read
+  // once its state is Finished.
+  HMBatch Candidates;
+  HMResults CandidateResults;
+  std::map<std::vector<double>, size_t> CandidateRows;
+  // Whether a candidate was added to the cache, and whether a request
+  // already has its result
+  std::vector<uint8_t> Collected, Awaited;
+  // State of the candidates, under Mutex
+  mutable std::mutex Mutex;
+  std::condition_variable SettledCV;
+  std::vector<uint8_t> State;
+  size_t NumUnsettled = 0;
+  bool Cancel = false;
+  std::thread Thread;
+
+  // Speculative results in the cache that were not requested yet
+  std::set<std::vector<double>> Unclaimed;
+  size_t NumEvaluated = 0;
+  size_t NumHits = 0;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_trace.h"
+
+using namespace std;
+
+const char *getPhaseName(HMPhase Phase) {
+  switch (Phase) {
+  case HMPhaseWait:
+    return "wait";
+  case HMPhaseParse:
+    return "parse";
+  case HMPhaseEval:
+    return "eval";
+  case HMPhaseFormat:
+    return "format";
+  case HMPhaseWrite:
+    return "write";
+  case HMPhaseCheckpoint:
+    return "checkpoint";
+  case HMNumPhases:
+    break;
+  }
+  return "unknown";
+}
+
+HMMeasurementStats getMeasurementStats(double *Values, size_t NumValues) {
+  HMMeasurementStats S;
+  if (!NumValues)
+    return S;
+  sort(Values, Values + NumValues);
+  size_t Mid = NumValues / 2;
+  S.Median = NumValues % 2 ? Values[Mid] : (Values[Mid - 1] + Values[Mid]) / 2;
+  S.Min = Values[0];
+  S.Max = Values[NumValues - 1];
+  double Sum = 0;
+  for (size_t i = 0; i < NumValues; i++)
+    Sum += Values[i];
+  S.Mean = Sum / NumValues;
+  double SquaredDev = 0;
+  for (size_t i = 0; i < NumValues; i++)
+    SquaredDev += (Values[i] - S.Mean) * (Values[i] - S.Mean);
+  if (NumValues > 1)
+    S.StdDev = sqrt(SquaredDev / (NumValues - 1));
+  return S;
+}
+
+HMTrace::HMTrace(bool _RecordEvents)
+    : Start(Clock::now()), RecordEvents(_RecordEvents) {}
+
+void HMTrace::setObjectives(const vector<string> &Names) {
+  ObjectiveNames = Names;
+  Spread.assign(Names.size(), SpreadStats());
+}
+
+void HMTrace::addMeasurement(long Iteration, size_t Row,
+                             const HMMeasurementStats *Objectives) {
+  for (size_t Obj = 0; Obj < ObjectiveNames.size(); Obj++) {
+    const HMMeasurementStats &M = Objectives[Obj];
+    // A zero median leaves the CV undefined
+    double CV = M.Median ? M.StdDev / fabs(M.Median) : 0;
+    SpreadStats &S = Spread[Obj];
+    S.Count++;
+    S.TotalCV += CV;
+    S.MaxCV = max(S.MaxCV, CV);
+  }
+  if (!RecordEvents)
+    return;
+  Measurements.push_back({Iteration, Row, MeasurementStats.size()});
+  MeasurementStats.insert(MeasurementStats.end(), Objectives,
+                          Objectives + ObjectiveNames.size());
+}
+
+void HMTrace::add(HMPhase Phase, Clock::time_point Begin,
+                  Clock::time_point End, size_t Iteration, size_t BatchSize) {
+  double Us = chrono::duration<double, micro>(End - Begin).count();
+  PhaseStats &S = Stats[Phase];
+  S.Count++;
+  S.TotalUs += Us;
+  S.MaxUs = max(S.MaxUs, Us);
+  size_t Bucket = Us < 2 ? 0 : size_t(log2(Us));
+  S.Histogram[min(Bucket, NumBuckets - 1)]++;
+  // A batch is counted once, by the phase every batch goes through
+  BatchSizeStats &B = ByBatchSize[BatchSize];
+  if (Phase == HMPhaseEval)
+    B.NumBatches++;
+  B.TotalUs[Phase] += Us;
+  if (RecordEvents)
+    Events.push_back(
+        {Phase, chrono::duration<double, micro>(Begin - Start).count(), Us,
+         Iteration, BatchSize});
+}
+
+// Opens Path for writing with fixed precision numbers
+static void openOutput(ofstream &Out, const string &Path) {
+  Out.open(Path);
+  if (Out.fail())
+    fatalError("Unable to open file: " + Path);
+  Out.setf(ios::fixed);
+  Out.precision(3);
+}
+
+void HMTrace::writeSummary(const string &Path) const {
+  ofstream Out;
+  openOutput(Out, Path);
+  Out << "{\n  \"phases\": {";
+  for (int P = 0; P < HMNumPhases; P++) {
+    const PhaseStats &S = Stats[P];
+    Out << (P ? "," : "") << "\n    \"" << getPhaseName(HMPhase(P))
+        << "\": {\"count\": " << S.Count
+        << ", \"total_ms\": " << S.TotalUs / 1e3
+        << ", \"mean_ms\": " << (S.Count ? S.TotalUs / 1e3 / S.Count : 0)
+        << ", \"max_ms\": " << S.MaxUs / 1e3 << ", \"histogram_us\": [";
+    // Non-empty buckets as [lower bound, count]
+    bool First = true;
+    for (size_t b = 0; b < NumBuckets; b++) {
+      if (!S.Histogram[b])
+        continue;
+      Out << (First ? "" : ", ") << "[" << (b ? size_t(1) << b : 0) << ", "
+          << S.Histogram[b] << "]";
+      First = false;
+    }
+    Out << "]}";
+  }
+  Out << "\n  },\n  \"batch_sizes\": [";
+  bool First = true;
+  for (auto &Entry : ByBatchSize) {
+    Out << (First ? "" : ",") << "\n    {\"batch_size\": " << Entry.first
+        << ", \"batches\": " << Entry.second.NumBatches;
+    for (int P = 0; P < HMNumPhases; P++)
+      Out << ", \"" << getPhaseName(HMPhase(P))
+          << "_ms\": " << Entry.second.TotalUs[P] / 1e3;
+    Out << "}";
+    First = false;
+  }
+  Out << "\n  ]";
+  if (!Spread.empty() && Spread[0].Count) {
+    // Measured values are in the objective's units, not milliseconds
+    Out.unsetf(ios::fixed);
+    Out.precision(6);
+    Out << ",\n  \"measurements\": {";
+    for (size_t Obj = 0; Obj < ObjectiveNames.size(); Obj++) {
+      const SpreadStats &S = Spread[Obj];
+      Out << (Obj ? "," : "") << "\n    \"" << ObjectiveNames[Obj]
+          << "\": {\"count\": " << S.Count
+          << ", \"mean_cv\": " << S.TotalCV / S.Count
+          << ", \"max_cv\": " << S.MaxCV << "}";
+    }
+    Out << "\n  },\n  \"configurations\": [";
+    for (size_t m = 0; m < Measurements.size(); m++) {
+      const Measurement &M = Measurements[m];
+      Out << (m ? "," : "") << "\n    {\"iteration\": " << M.Iteration
+          << ", \"row\": " << M.Row;
+      for (size_t Obj = 0; Obj < ObjectiveNames.size(); Obj++) {
+        const HMMeasurementStats &S = MeasurementStats[M.First + Obj];
+        Out << ", \"" << ObjectiveNames[Obj] << "\": {\"median\": "
+            << S.Median << ", \"mean\": " << S.Mean
+            << ", \"stddev\": " << S.StdDev << ", \"min\": " << S.Min
+            << ", \"max\": " << S.Max << "}";
+      }
+      Out << "}";
+    }
+    Out << "\n  ]";
+  }
+  Out << "\n}\n";
+  if (Out.fail())
+    fatalError("Unable to write file: " + Path);
+}
+
+void HMTrace::writeChromeTrace(const string &Path) const {
+  ofstream Out;
+  openOutput(Out, Path);
+  // Waiting for HyperMapper and the client's own phases go on two tracks
+  int Pid = getpid();
+  Out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+      << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << Pid
+      << ", \"tid\": 1, \"args\": {\"name\": \"client\"}},\n"
+      << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << Pid
+      << ", \"tid\": 2, \"args\": {\"name\": \"HyperMapper\"}}";
+  for (const Event &E : Events)
+    Out << ",\n{\"name\": \"" << getPhaseName(E.Phase)
+        << "\", \"cat\": \"hm\", \"ph\": \"X\", \"ts\": " << E.StartUs
+        << ", \"dur\": " << E.DurationUs << ", \"pid\": " << Pid
+        << ", \"tid\": " << (E.Phase == HMPhaseWait ? 2 : 1)
+        << ", \"args\": {\"iteration\": " << E.Iteration
+        << ", \"batch_size\": " << E.BatchSize << "}}";
+  Out << "\n]}\n";
+  if (Out.fail())
+    fatalError("Unable to write file: " + Path);
+}
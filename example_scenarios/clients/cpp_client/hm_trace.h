@@ -0,0 +1,126 @@
+#ifndef HM_TRACE_H
+#define HM_TRACE_H
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Phases of one iteration of the protocol loop
+enum HMPhase {
+  // Blocked until HyperMapper sends the next request, i.e. model fitting
+  // and sampling in the optimizer
+  HMPhaseWait,
+  // Reading and parsing the header and the parameter values
+  HMPhaseParse,
+  // Cache lookups and evaluation of the objective
+  HMPhaseEval,
+  // Assembling the reply
+  HMPhaseFormat,
+  // Writing the reply to the pipe or the reply file
+  HMPhaseWrite,
+  // Appending the batch to the checkpoint log
+  HMPhaseCheckpoint,
+  HMNumPhases
+};
+
+// Name of Phase as used in the exported files
+const char *getPhaseName(HMPhase Phase);
+
+// Spread of the repeated measurements of one objective of a configuration
+struct HMMeasurementStats {
+  double Median = 0;
+  double Mean = 0;
+  double StdDev = 0;
+  double Min = 0;
+  double Max = 0;
+};
+
+// Statistics of the NumValues values at Values, which are sorted in place.
+// The median of an even number of values is the mean of the middle two.
+HMMeasurementStats getMeasurementStats(double *Values, size_t NumValues);
+
+// Wall-clock time spent in every phase of the protocol loop. Keeps totals,
+// a histogram per phase and totals per batch size, and optionally every
+// timed interval for a Chrome trace (chrome://tracing or Perfetto).
+class HMTrace {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Histogram bucket b counts intervals of [2^b, 2^(b+1)) microseconds,
+  // bucket 0 also the shorter ones
+  static constexpr size_t NumBuckets = 40;
+
+  struct PhaseStats {
+    size_t Count = 0;
+    double TotalUs = 0;
+    double MaxUs = 0;
+    std::array<size_t, NumBuckets> Histogram{};
+  };
+
+  // Spread of the repeated measurements of one objective over the
+  // configurations. CV is the standard deviation relative to the median.
+  struct SpreadStats {
+    size_t Count = 0;
+    double TotalCV = 0;
+    double MaxCV = 0;
+  };
+
+  explicit HMTrace(bool RecordEvents = false);
+
+  // Names of the objectives addMeasurement records
+  void setObjectives(const std::vector<std::string> &Names);
+
+  // Records the spread of the objectives of configuration Row of iteration
+  // Iteration, -1 for the client's design of experiments. The statistics
+  // of every configuration are only kept when recording events.
+  void addMeasurement(long Iteration, size_t Row,
+                      const HMMeasurementStats *Objectives);
+  const SpreadStats &getSpread(size_t Obj) const { return Spread[Obj]; }
+
+  // Records that Phase of iteration Iteration, a batch of BatchSize
+  // configurations, ran from Begin to End
+  void add(HMPhase Phase, Clock::time_point Begin, Clock::time_point End,
+           size_t Iteration, size_t BatchSize);
+
+  const PhaseStats &getStats(HMPhase Phase) const { return Stats[Phase]; }
+  double getTotalMs(HMPhase Phase) const { return Stats[Phase].TotalUs / 1e3; }
+
+  // Writes the totals, histograms, per batch size totals and measurement
+  // spread as JSON
+  void writeSummary(const std::string &Path) const;
+  // Writes the recorded intervals in Chrome trace-event format
+  void writeChromeTrace(const std::string &Path) const;
+
+private:
+  struct Event {
+    HMPhase Phase;
+    double StartUs;
+    double DurationUs;
+    size_t Iteration;
+    size_t BatchSize;
+  };
+  struct BatchSizeStats {
+    size_t NumBatches = 0;
+    std::array<double, HMNumPhases> TotalUs{};
+  };
+
+  struct Measurement {
+    long Iteration;
+    size_t Row;
+    size_t First;
+  };
+
+  Clock::time_point Start;
+  bool RecordEvents;
+  std::vector<std::string> ObjectiveNames;
+  std::vector<SpreadStats> Spread;
+  std::vector<Measurement> Measurements;
+  std::vector<HMMeasurementStats> MeasurementStats;
+  std::array<PhaseStats, HMNumPhases> Stats;
+  std::map<size_t, BatchSizeStats> ByBatchSize;
+  std::vector<Event> Events;
+};
+
+#endif
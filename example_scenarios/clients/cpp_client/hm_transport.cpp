@@ -0,0 +1,184 @@
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "cpp_client.h"
+#include "hm_transport.h"
+
+using namespace std;
+
+// Socket buffer size, large enough for a big batch to be in flight without
+// blocking the sender
+static constexpr int SocketBufferSize = 4 << 20;
+
+HMTransport::~HMTransport() { HMTransport::close(); }
+
+void HMTransport::close(bool) {
+  if (ReadFD >= 0)
+    ::close(ReadFD);
+  if (WriteFD >= 0 && WriteFD != ReadFD)
+    ::close(WriteFD);
+  ReadFD = WriteFD = -1;
+}
+
+// HyperMapper spawned by the client, talking over a pipe pair
+class HMPipeTransport : public HMTransport {
+public:
+  explicit HMPipeTransport(const string &Command) {
+    int ToChild[2], FromChild[2];
+    if (pipe2(ToChild, O_CLOEXEC))
+      fatalError(string("Unable to create pipe: ") + strerror(errno));
+    if (pipe2(FromChild, O_CLOEXEC)) {
+      ::close(ToChild[0]);
+      ::close(ToChild[1]);
+      fatalError(string("Unable to create pipe: ") + strerror(errno));
+    }
+    cout.flush();
+    Pid = fork();
+    if (Pid < 0) {
+      for (int FD : {ToChild[0], ToChild[1], FromChild[0], FromChild[1]})
+        ::close(FD);
+      fatalError(string("Unable to launch HyperMapper: ") + strerror(errno));
+    }
+    if (Pid == 0) {
+      // dup2 clears close-on-exec on the new descriptors only
+      dup2(ToChild[0], 0);
+      dup2(FromChild[1], 1);
+      execl("/bin/sh", "sh", "-c", Command.c_str(), nullptr);
+      perror("execl");
+      _exit(127);
+    }
+    ::close(ToChild[0]);
+    ::close(FromChild[1]);
+    WriteFD = ToChild[1];
+    ReadFD = FromChild[0];
+    Description = "process " + to_string(Pid);
+  }
+
+  ~HMPipeTransport() override { close(true); }
+
+  void close(bool Abort) override {
+    HMTransport::close();
+    if (Pid <= 0)
+      return;
+    if (Abort)
+      kill(Pid, SIGTERM);
+    while (waitpid(Pid, nullptr, 0) < 0 && errno == EINTR)
+      ;
+    Pid = -1;
+  }
+
+private:
+  pid_t Pid = -1;
+};
+
+// HyperMapper running elsewhere, one socket for both directions
+class HMSocketTransport : public HMTransport {
+public:
+  HMSocketTransport(const string &Address, double RetrySeconds) {
+    ReadFD = WriteFD = connectSocket(Address, RetrySeconds);
+    Description = Address;
+  }
+};
+
+unique_ptr<HMTransport> spawnHyperMapper(const string &Command) {
+  return unique_ptr<HMTransport>(new HMPipeTransport(Command));
+}
+
+unique_ptr<HMTransport> connectHyperMapper(const string &Address,
+                                           double RetrySeconds,
+                                           HMLogLevel LogLevel) {
+  HM_LOG(LogLevel, HMLogSummary,
+         "Connecting to HyperMapper at " << Address << endl);
+  return unique_ptr<HMTransport>(new HMSocketTransport(Address, RetrySeconds));
+}
+
+// New stream socket with the large buffers. They are set before connect(),
+// since TCP fixes its window scale during the handshake.
+static int openSocket(int Family, int Protocol) {
+  int FD = socket(Family, SOCK_STREAM | SOCK_CLOEXEC, Protocol);
+  if (FD >= 0) {
+    setsockopt(FD, SOL_SOCKET, SO_SNDBUF, &SocketBufferSize,
+               sizeof(SocketBufferSize));
+    setsockopt(FD, SOL_SOCKET, SO_RCVBUF, &SocketBufferSize,
+               sizeof(SocketBufferSize));
+  }
+  return FD;
+}
+
+// Connects a new socket to one of the addresses of Address. Returns -1 with
+// errno set if none accepts.
+static int tryConnect(const string &Address) {
+  constexpr char UnixPrefix[] = "unix:";
+  if (Address.compare(0, sizeof(UnixPrefix) - 1, UnixPrefix) == 0) {
+    string Path = Address.substr(sizeof(UnixPrefix) - 1);
+    sockaddr_un Addr;
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    if (Path.empty() || Path.size() >= sizeof(Addr.sun_path))
+      fatalError("Invalid Unix socket path: " + Path);
+    memcpy(Addr.sun_path, Path.data(), Path.size());
+    int FD = openSocket(AF_UNIX, 0);
+    if (FD >= 0 && connect(FD, reinterpret_cast<sockaddr *>(&Addr),
+                           sizeof(Addr))) {
+      int Err = errno;
+      ::close(FD);
+      errno = Err;
+      return -1;
+    }
+    return FD;
+  }
+
+  size_t Colon = Address.rfind(':');
+  if (Colon == string::npos)
+    fatalError("Address is not host:port or unix:path: " + Address);
+  string Host = Address.substr(0, Colon), Port = Address.substr(Colon + 1);
+  addrinfo Hints;
+  memset(&Hints, 0, sizeof(Hints));
+  Hints.ai_family = AF_UNSPEC;
+  Hints.ai_socktype = SOCK_STREAM;
+  addrinfo *Addresses;
+  if (int Err = getaddrinfo(Host.c_str(), Port.c_str(), &Hints, &Addresses))
+    fatalError("Unable to resolve " + Address + ": " + gai_strerror(Err));
+  int FD = -1, Err = 0;
+  for (addrinfo *AI = Addresses; AI && FD < 0; AI = AI->ai_next) {
+    FD = openSocket(AI->ai_family, AI->ai_protocol);
+    if (FD >= 0 && connect(FD, AI->ai_addr, AI->ai_addrlen)) {
+      Err = errno;
+      ::close(FD);
+      FD = -1;
+    }
+  }
+  freeaddrinfo(Addresses);
+  if (FD < 0)
+    errno = Err;
+  int One = 1;
+  if (FD >= 0)
+    setsockopt(FD, IPPROTO_TCP, TCP_NODELAY, &One, sizeof(One));
+  return FD;
+}
+
+int connectSocket(const string &Address, double RetrySeconds) {
+  auto Deadline = chrono::steady_clock::now() +
+                  chrono::duration_cast<chrono::steady_clock::duration>(
+                      chrono::duration<double>(RetrySeconds));
+  int FD;
+  // The listener may not be up yet
+  while ((FD = tryConnect(Address)) < 0 &&
+         (errno == ECONNREFUSED || errno == ENOENT) &&
+         chrono::steady_clock::now() < Deadline)
+    this_thread::sleep_for(chrono::milliseconds(100));
+  if (FD < 0)
+    fatalError("Unable to connect to " + Address + ": " + strerror(errno));
+  return FD;
+}
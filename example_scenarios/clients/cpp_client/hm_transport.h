@@ -0,0 +1,51 @@
+#ifndef HM_TRANSPORT_H
+#define HM_TRANSPORT_H
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "hm_log.h"
+
+// Byte stream between the client and HyperMapper. The protocol loop reads
+// from getReadFD() with an HMLineReader and writes to getWriteFD(), so the
+// same loop runs over a pipe pair to a spawned HyperMapper or over a socket
+// to one running elsewhere.
+class HMTransport {
+public:
+  virtual ~HMTransport();
+
+  HMTransport(const HMTransport &) = delete;
+  HMTransport &operator=(const HMTransport &) = delete;
+
+  int getReadFD() const { return ReadFD; }
+  int getWriteFD() const { return WriteFD; }
+  // Human readable peer, for log messages
+  const std::string &getDescription() const { return Description; }
+
+  // Closes the connection. A spawned HyperMapper is waited for, or
+  // terminated first with Abort.
+  virtual void close(bool Abort = false);
+
+protected:
+  HMTransport() = default;
+
+  int ReadFD = -1;
+  int WriteFD = -1;
+  std::string Description;
+};
+
+// Runs Command through /bin/sh with its stdin and stdout connected to
+// pipes
+std::unique_ptr<HMTransport> spawnHyperMapper(const std::string &Command);
+
+// Connects to a HyperMapper listening on Address (see connectSocket)
+std::unique_ptr<HMTransport> connectHyperMapper(const std::string &Address,
+                                                double RetrySeconds,
+                                                HMLogLevel LogLevel);
+
+// Opens a stream socket to Address, either unix:<path> for a Unix domain
+// socket or <host>:<port> for TCP, with large buffers and without Nagle's
+// algorithm. Refused connections are retried for RetrySeconds.
+int connectSocket(const std::string &Address, double RetrySeconds = 0);
+
+#endif
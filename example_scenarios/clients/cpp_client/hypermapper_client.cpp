@@ -0,0 +1,1181 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "hm_autotune.h"
+#include "hm_cache.h"
+#include "hm_checkpoint.h"
+#include "hm_doe.h"
+#include "hm_early_stop.h"
+#include "hm_pareto.h"
+#include "hm_process_pool.h"
+#include "hm_protocol.h"
+#include "hm_remote.h"
+#include "hm_reorder.h"
+#include "hm_scheduler.h"
+#include "hm_session.h"
+#include "hm_speculate.h"
+#include "hm_trace.h"
+#include "hm_transport.h"
+#include "hypermapper_client.h"
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+void fatalError(const string &msg) { throw HMError(msg); }
+
+HMLogLevel parseLogLevel(const char *Name, HMLogLevel Default) {
+  if (!Name)
+    return Default;
+  string Level(Name);
+  if (Level == "off")
+    return HMLogOff;
+  if (Level == "summary")
+    return HMLogSummary;
+  if (Level == "trace")
+    return HMLogTrace;
+  cerr << "Unknown HM_LOG_LEVEL " << Level << ", ignoring it" << endl;
+  return Default;
+}
+
+// Milliseconds elapsed between two time points
+static double elapsedMs(chrono::steady_clock::time_point Start,
+                        chrono::steady_clock::time_point End) {
+  return chrono::duration<double, milli>(End - Start).count();
+}
+
+// Path of the log of the answered configurations of Scenario
+static string getCheckpointPath(const HMScenario &Scenario) {
+  return string(fs::current_path()) + "/" + Scenario.OutputFoldername + "/" +
+         Scenario.AppName + "_checkpoint.csv";
+}
+
+// Writes Data to the named pipe Path once HyperMapper opens it. Returns
+// false if HyperMapper sends something or exits first, as it does when its
+// optimization method does not resume.
+static bool writeResumePipe(const string &Path, string_view Data,
+                            int FromHyperMapper) {
+  int FD;
+  // Opening for writing without blocking fails until there is a reader
+  while ((FD = open(Path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+    if (errno != ENXIO && errno != EINTR)
+      fatalError("Unable to open " + Path + ": " + strerror(errno));
+    pollfd HyperMapper = {FromHyperMapper, POLLIN | POLLRDHUP, 0};
+    if (poll(&HyperMapper, 1, 10) > 0)
+      return false;
+  }
+  fcntl(FD, F_SETFL, fcntl(FD, F_GETFL) & ~O_NONBLOCK);
+  while (!Data.empty()) {
+    ssize_t Written = write(FD, Data.data(), Data.size());
+    if (Written < 0 && errno == EINTR)
+      continue;
+    if (Written < 0) {
+      int Err = errno;
+      close(FD);
+      fatalError("Error writing to " + Path + ": " + strerror(Err));
+    }
+    Data.remove_prefix(Written);
+  }
+  close(FD);
+  return true;
+}
+
+double HMConfig::getReal(size_t Idx) const {
+  double Value = Batch.get(Row, Idx);
+  const HMInputParam &Param = *Params[Idx];
+  if (Param.getType() == Categorical && Param.hasNumericCategories())
+    return Param.getRange()[size_t(Value)];
+  return Value;
+}
+
+int HMConfig::getInt(size_t Idx) const { return lround(getReal(Idx)); }
+
+const string &HMConfig::getCategory(size_t Idx) const {
+  const HMInputParam &Param = *Params[Idx];
+  if (Param.getType() != Categorical)
+    fatalError("Parameter " + Param.getName() + " is not categorical");
+  return Param.getCategories()[getCategoryIndex(Idx)];
+}
+
+size_t HMConfig::getIndex(const string &Name) const {
+  for (size_t i = 0; i < Params.size(); i++)
+    if (Params[i]->getName() == Name)
+      return i;
+  fatalError("Unknown parameter name: " + Name);
+}
+
+uint64_t getScenarioSignature(const HMScenario &Scenario) {
+  string Description;
+  for (size_t i = 0; i < Scenario.InParams.size(); i++) {
+    const HMInputParam *InParam = Scenario.InParams[i];
+    Description +=
+        getParamKey(i) + ":" + getTypeAsString(InParam->getType()) + ":";
+    for (double V : InParam->getRange())
+      Description += HMInputParam::formatValue(V) + ",";
+    for (auto &C : InParam->getCategories())
+      Description += C + ",";
+    Description += "\n";
+  }
+  for (auto &objString : Scenario.Objectives)
+    Description += objString + ",";
+  Description += "\n";
+  for (auto &metricString : Scenario.Metrics)
+    Description += metricString + ",";
+  return hashBytes(Description.data(), Description.size());
+}
+
+HMEvaluator &HyperMapperClient::getEvaluator(int NumCPUs,
+                                             HMPlacement Placement) {
+  if (!Evaluator || EvaluatorCPUs != NumCPUs ||
+      Evaluator->getPlacement() != Placement) {
+    Evaluator.reset();
+    Evaluator.reset(new HMEvaluator(NumCPUs, Placement));
+    EvaluatorCPUs = NumCPUs;
+  }
+  return *Evaluator;
+}
+
+void HyperMapperClient::run(const HMScenario &Scenario,
+                            const HMObjectiveFn &Objective) {
+  if (Scenario.AutoTuneIterations > 0)
+    autoTune(Scenario, Objective, nullptr);
+  else
+    runStudy(Scenario, Objective, nullptr);
+}
+
+void HyperMapperClient::run(const HMScenario &Scenario,
+                            const HMBatchObjectiveFn &BatchObjective) {
+  // One configuration at a time, for the evaluators that only take those
+  size_t NumParams = Scenario.InParams.size();
+  size_t NumMetrics = Scenario.Metrics.size();
+  HMObjectiveFn Objective = [&](const HMConfig &Config, HMObjective &Obj) {
+    HMBatch Batch;
+    Batch.resize(1, NumParams);
+    for (size_t param = 0; param < NumParams; param++)
+      Batch.at(0, param) = Config.getParam(param).getType() == Categorical
+                               ? Config.getCategoryIndex(param)
+                               : Config.getReal(param);
+    HMResults Results;
+    Results.reset(1, Obj.size(), NumMetrics);
+    HMBatchSlice Slice(Batch, Results, 0, 1);
+    BatchObjective(Slice);
+    for (size_t obj = 0; obj < Obj.size(); obj++)
+      Obj[obj] = Results.objective(obj)[0];
+    for (size_t metric = 0; metric < NumMetrics; metric++)
+      Obj.metric(metric) = Results.metric(metric)[0];
+    Obj.setFeasible(Results.feasible()[0]);
+  };
+  if (Scenario.AutoTuneIterations > 0)
+    autoTune(Scenario, Objective, &BatchObjective);
+  else
+    runStudy(Scenario, Objective, &BatchObjective);
+}
+
+void HyperMapperClient::runStudy(const HMScenario &Scenario,
+                                 const HMObjectiveFn &Objective,
+                                 const HMBatchObjectiveFn *BatchObjective) {
+  // Early stopping reports the fidelity of every configuration. The agents
+  // describe the same outputs as their scenario, without it.
+  if (Scenario.EarlyStopping && Scenario.Agents.empty() &&
+      find(Scenario.Metrics.begin(), Scenario.Metrics.end(), "Fidelity") ==
+          Scenario.Metrics.end()) {
+    HMScenario WithFidelity = Scenario;
+    WithFidelity.Metrics.push_back("Fidelity");
+    runStudy(WithFidelity, Objective, BatchObjective);
+    return;
+  }
+  const char *ConnectEnv = getenv("HM_CONNECT");
+  string Connect = ConnectEnv ? ConnectEnv : Scenario.Connect;
+  if (Scenario.ServerCommand.empty() && Connect.empty() && !Session &&
+      (!getenv("HYPERMAPPER_HOME") || !getenv("PYTHONPATH"))) {
+    string ErrMsg = "Environment variables are not set!\n";
+    ErrMsg += "Please set HYPERMAPPER_HOME and PYTHONPATH before running this ";
+    fatalError(ErrMsg);
+  }
+
+  HMLogLevel LogLevel =
+      parseLogLevel(getenv("HM_LOG_LEVEL"), Scenario.LogLevel);
+  const vector<HMInputParam *> &InParams = Scenario.InParams;
+  const vector<string> &Objectives = Scenario.Objectives;
+  int numParams = InParams.size();
+  if (Scenario.TypedParams && Scenario.TypedParams->size() != InParams.size())
+    fatalError("Input parameters changed after HMSpace::describe");
+
+  // Columns of a samples csv HyperMapper can resume from
+  string SampleHeader;
+  for (size_t i = 0; i < InParams.size(); i++)
+    SampleHeader += getParamKey(i) + ",";
+  for (auto &objString : Objectives)
+    SampleHeader += objString + ",";
+  if (Scenario.Predictor)
+    SampleHeader += "Valid,";
+  for (auto &metricString : Scenario.Metrics)
+    SampleHeader += metricString + ",";
+  SampleHeader += "Timestamp";
+  string OutputDir =
+      string(fs::current_path()) + "/" + Scenario.OutputFoldername;
+
+  // Log of the answered configurations. When it holds some, HyperMapper
+  // resumes from it instead of starting over.
+  auto RunStart = chrono::steady_clock::now();
+  HMCheckpoint Checkpoint;
+  string ResumeDataFile;
+  if (Scenario.Checkpoint) {
+    fs::create_directories(OutputDir);
+    Checkpoint.open(getCheckpointPath(Scenario), SampleHeader, LogLevel);
+    if (Checkpoint.size() > 0)
+      ResumeDataFile = Checkpoint.getPath();
+  }
+
+  // The client's design of experiments reaches HyperMapper as resume data
+  // through a named pipe, which it blocks on until the samples are
+  // evaluated. A resumed study has its samples already.
+  string DOEPath;
+  if (Scenario.ClientDOE && ResumeDataFile.empty() && Scenario.NumSamples > 0) {
+    fs::create_directories(OutputDir);
+    DOEPath = OutputDir + "/" + Scenario.AppName + "_doe.csv";
+    unlink(DOEPath.c_str());
+    if (mkfifo(DOEPath.c_str(), 0600))
+      fatalError("Unable to create " + DOEPath + ": " + strerror(errno));
+    ResumeDataFile = DOEPath;
+  }
+  double ResumedTimestamp = Checkpoint.getLastTimestamp();
+  HMResponseWriter CheckpointRow;
+
+  // Create json scenario
+  string JSonFileNameStr =
+      createScenarioFile(Scenario, LogLevel, ResumeDataFile);
+
+  HMBatch Batch;
+  HMResults Results;
+  size_t NumObjectives = Objectives.size();
+  size_t NumMetrics = Scenario.Metrics.size();
+  size_t NumOutputs = NumObjectives + NumMetrics;
+
+  // Time spent in each phase of the loop
+  HMTrace Trace(Scenario.Trace);
+
+  // Repeated measurements run locally, the agents evaluate with their own
+  // objective
+  int Repeats = max(Scenario.Repeats, 1);
+  if (Repeats > 1 && !Scenario.Agents.empty()) {
+    HM_LOG(LogLevel, HMLogSummary,
+           "Agents evaluate every configuration once, ignoring Repeats"
+               << endl);
+    Repeats = 1;
+  }
+  if (Repeats > 1) {
+    // Repeats of a configuration run back to back on its worker
+    BatchObjective = nullptr;
+    Trace.setObjectives(Objectives);
+  }
+  // Evaluates Config Repeats times. The median of every output and the
+  // feasibility most repeats reported go to Obj, the spread of the
+  // objectives to Spread if given.
+  auto measure = [&, Repeats](const HMConfig &Config, HMObjective &Obj,
+                              HMMeasurementStats *Spread) {
+    HMResults Samples;
+    Samples.reset(Repeats, NumObjectives, NumMetrics);
+    for (int repeat = 0; repeat < Repeats; repeat++) {
+      HMObjective Sample(Samples, repeat);
+      Objective(Config, Sample);
+    }
+    for (size_t obj = 0; obj < NumObjectives; obj++) {
+      HMMeasurementStats S =
+          getMeasurementStats(Samples.objective(obj), Repeats);
+      Obj[obj] = S.Median;
+      if (Spread)
+        Spread[obj] = S;
+    }
+    for (size_t metric = 0; metric < NumMetrics; metric++)
+      Obj.metric(metric) =
+          getMeasurementStats(Samples.metric(metric), Repeats).Median;
+    const uint8_t *Feasible = Samples.feasible();
+    Obj.setFeasible(2 * count(Feasible, Feasible + Repeats, 1) >= Repeats);
+  };
+  HMObjectiveFn Measured = Objective;
+  if (Repeats > 1)
+    Measured = [&](const HMConfig &Config, HMObjective &Obj) {
+      measure(Config, Obj, nullptr);
+    };
+  // Column of the Fidelity metric added for early stopping. Configurations
+  // evaluated outside the protocol loop's threads always run in full.
+  bool ReportFidelity = Scenario.EarlyStopping && Scenario.Agents.empty();
+  size_t FidelityColumn = 0;
+  if (ReportFidelity) {
+    FidelityColumn = NumObjectives + (find(Scenario.Metrics.begin(),
+                                           Scenario.Metrics.end(),
+                                           "Fidelity") -
+                                      Scenario.Metrics.begin());
+    Measured = [&, Inner = Measured](const HMConfig &Config,
+                                     HMObjective &Obj) {
+      Inner(Config, Obj);
+      Obj.metric(FidelityColumn - NumObjectives) = 1;
+    };
+  }
+  // Neighbours of the best configurations evaluated while HyperMapper fits
+  // its model, answered from the cache when they are requested. The worker
+  // processes and agents only evaluate batches.
+  size_t Speculate = Scenario.Speculate;
+  if (Speculate && (!Scenario.Agents.empty() || Scenario.WorkerProcesses)) {
+    HM_LOG(LogLevel, HMLogSummary,
+           "Speculative evaluation needs in-process workers, disabling it"
+               << endl);
+    Speculate = 0;
+  }
+
+  // Create evaluator that runs the configurations of a request in parallel,
+  // either on threads of this process, in worker processes or on remote
+  // agents. Speculative evaluations go on while the next batch is evaluated,
+  // so a study speculating without shared workers schedules its own.
+  HMEvaluator *Evaluator = nullptr;
+  unique_ptr<HMScheduler> StudyScheduler;
+  HMScheduler *Workers = Scheduler;
+  HMCPUSet ProtocolCPUs;
+  Stats = HMRunStats();
+  unique_ptr<HMProcessPool> Pool;
+  unique_ptr<HMRemotePool> Remote;
+  if (!Scenario.Agents.empty()) {
+    Remote.reset(new HMRemotePool(Scenario.Agents,
+                                  getScenarioSignature(Scenario), numParams,
+                                  NumObjectives, NumMetrics, LogLevel));
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluating on " << Remote->getNumAgents() << " agents with "
+                            << Remote->getNumSlots() << " slots" << endl);
+    Stats.NumWorkers = Remote->getNumSlots();
+  } else if (Scenario.WorkerProcesses) {
+    Pool.reset(new HMProcessPool(
+        Scenario.NumCPUs, numParams, NumObjectives, NumMetrics,
+        Scenario.EvalTimeout, [&](const HMBatch &Config, HMResults &Result) {
+          HMObjective Obj(Result, 0);
+          Measured(HMConfig(InParams, Config, 0), Obj);
+        }));
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluating with " << Pool->getNumWorkers() << " worker processes"
+                              << endl);
+    Stats.NumWorkers = Pool->getNumWorkers();
+  } else if (Scheduler) {
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluating with " << Scheduler->getNumWorkers()
+                              << " shared workers, priority "
+                              << Scenario.Priority << endl);
+    Stats.NumWorkers = Scheduler->getNumWorkers();
+    ProtocolCPUs = Scheduler->getProtocolCPUs();
+  } else if (Speculate) {
+    StudyScheduler.reset(
+        new HMScheduler(Scenario.NumCPUs, Scenario.Placement));
+    Workers = StudyScheduler.get();
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluating with " << Workers->getNumWorkers()
+                              << " workers shared with speculation" << endl);
+    Stats.NumWorkers = Workers->getNumWorkers();
+    ProtocolCPUs = Workers->getProtocolCPUs();
+  } else {
+    Evaluator = &getEvaluator(Scenario.NumCPUs, Scenario.Placement);
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluating with " << Evaluator->getNumWorkers() << " workers"
+                              << (Scenario.Placement == HMPlaceAny
+                                      ? ""
+                                      : string(" pinned per ") +
+                                            getPlacementName(
+                                                Scenario.Placement))
+                              << endl);
+    Stats.NumWorkers = Evaluator->getNumWorkers();
+    ProtocolCPUs = Evaluator->getProtocolCPUs();
+  }
+  // Interim estimates are compared with the front of the configurations
+  // evaluated in full while the batch runs
+  unique_ptr<HMEarlyStop> EarlyStop;
+  if (Scenario.EarlyStopping) {
+    if (!ReportFidelity || Pool || Repeats > 1) {
+      HM_LOG(LogLevel, HMLogSummary,
+             "Early stopping needs single evaluations on in-process workers, "
+             "disabling it"
+                 << endl);
+    } else {
+      EarlyStop.reset(new HMEarlyStop(NumObjectives, FidelityColumn,
+                                      Scenario.EarlyStopMargin,
+                                      Scenario.EarlyStopMinFidelity));
+      // Estimates are reported per configuration
+      BatchObjective = nullptr;
+    }
+  }
+  // Spread of the objectives of the configurations of the batch
+  vector<HMMeasurementStats> Spread;
+  HMEvaluator::ObjectiveFn EvalFn = [&](size_t Config) {
+    HMObjective Obj(Results, Config, EarlyStop.get());
+    if (Repeats > 1)
+      measure(HMConfig(InParams, Batch, Config), Obj,
+              &Spread[Config * NumObjectives]);
+    else
+      Objective(HMConfig(InParams, Batch, Config), Obj);
+    if (EarlyStop)
+      EarlyStop->finish(Results, Config);
+    else if (ReportFidelity)
+      Results.at(Config, FidelityColumn) = 1;
+  };
+  // Failed evaluations report the worst value seen so far for every
+  // objective, so HyperMapper's models never see NaN
+  vector<uint8_t> Failed;
+  vector<double> WorstObjectives(NumObjectives, -HUGE_VAL);
+  size_t NumFailed = 0;
+
+  bool UseCache = Scenario.CacheEvaluations || Speculate;
+
+  // Results of earlier evaluations, loaded before HyperMapper is started
+  HMEvalCache Cache;
+  if (UseCache)
+    Cache.open(string(fs::current_path()) + "/" + Scenario.OutputFoldername +
+                   "/" + Scenario.AppName + "_eval_cache.bin",
+               getScenarioSignature(Scenario), numParams, NumOutputs, LogLevel);
+  vector<double> CacheKey(numParams), CacheOutputs(NumOutputs);
+  vector<size_t> Misses, Awaited;
+  unique_ptr<HMSpeculator> Speculator;
+  if (Speculate)
+    Speculator.reset(new HMSpeculator(InParams, NumObjectives, NumMetrics,
+                                      Speculate, Measured));
+  // Speculative batches only take the workers the batches of every study
+  // leave idle
+  HMSpeculator::RunFn runSpeculation =
+      [&](size_t NumConfigs, const HMEvaluator::ObjectiveFn &Fn) {
+        Workers->evaluateBackground(NumConfigs, Fn);
+      };
+  size_t NumSpeculativeHits = 0;
+  // Finished rows of the batch in request order, see the protocol loop
+  HMReorderBuffer Reorder;
+  auto completeRow = [&](size_t Row) { Reorder.complete(Row); };
+  HMEvaluator::ObjectiveFn EvalMissFn = [&](size_t Miss) {
+    EvalFn(Misses[Miss]);
+    completeRow(Misses[Miss]);
+  };
+  // A batch objective evaluates contiguous slices of the misses, taken
+  // from the batch when they are all of it and from a copy otherwise
+  HMBatch MissBatch;
+  HMResults MissResults;
+  auto evaluateMissSlices = [&](size_t NumRows) {
+    size_t NumMisses = Misses.size();
+    if (!NumMisses)
+      return;
+    bool Gather = NumMisses != NumRows;
+    if (Gather) {
+      MissBatch.resize(NumMisses, numParams);
+      for (int param = 0; param < numParams; param++)
+        for (size_t miss = 0; miss < NumMisses; miss++)
+          MissBatch.at(miss, param) = Batch.get(Misses[miss], param);
+      MissResults.reset(NumMisses, NumObjectives, NumMetrics);
+    }
+    HMResults &Out = Gather ? MissResults : Results;
+    // A few slices per worker balance the load
+    size_t NumSlices = min<size_t>(NumMisses, 4 * Stats.NumWorkers);
+    size_t SliceSize = (NumMisses + NumSlices - 1) / NumSlices;
+    NumSlices = (NumMisses + SliceSize - 1) / SliceSize;
+    HMEvaluator::ObjectiveFn SliceFn = [&](size_t S) {
+      size_t Begin = S * SliceSize, End = min(NumMisses, Begin + SliceSize);
+      HMBatchSlice Slice(Gather ? MissBatch : Batch, Out, Begin, End);
+      (*BatchObjective)(Slice);
+      for (size_t miss = Begin; miss < End; miss++) {
+        size_t Row = Misses[miss];
+        if (Gather) {
+          for (size_t out = 0; out < NumOutputs; out++)
+            Results.at(Row, out) = MissResults.at(miss, out);
+          Results.feasibleAt(Row) = MissResults.feasible()[miss];
+        }
+        completeRow(Row);
+      }
+    };
+    if (Workers)
+      Workers->evaluate(NumSlices, SliceFn, Scenario.Priority);
+    else
+      Evaluator->evaluate(NumSlices, SliceFn);
+  };
+
+  // Evaluates the NumRows configurations of Batch, requested in iteration
+  // Iteration, into Results, answering the ones known from the cache, and
+  // returns how many failed. Every row goes through Reorder, which must be
+  // reset for the batch.
+  auto evaluateBatch = [&](size_t NumRows, long Iteration) {
+    // Answer known configurations from the cache and evaluate the rest
+    Misses.clear();
+    Awaited.clear();
+    NumSpeculativeHits = 0;
+    if (EarlyStop)
+      EarlyStop->reset(NumRows);
+    for (size_t request = 0; request < NumRows; request++) {
+      if (!UseCache) {
+        Misses.push_back(request);
+        continue;
+      }
+      for (int param = 0; param < numParams; param++)
+        CacheKey[param] = Batch.get(request, param) + 0.0; // No -0.0
+      const double *Cached = Cache.lookup(CacheKey.data());
+      if (!Cached) {
+        // Still being evaluated speculatively
+        if (Speculator && Speculator->isPending(CacheKey.data()))
+          Awaited.push_back(request);
+        else
+          Misses.push_back(request);
+        continue;
+      }
+      for (size_t out = 0; out < NumOutputs; out++)
+        Results.at(request, out) = Cached[out];
+      Results.feasibleAt(request) = Cached[NumOutputs] != 0;
+      if (EarlyStop && Results.feasibleAt(request))
+        EarlyStop->add(Results, request);
+      if (Speculator && Speculator->claim(CacheKey.data()))
+        NumSpeculativeHits++;
+      completeRow(request);
+    }
+    if (Repeats > 1)
+      Spread.resize(NumRows * NumObjectives);
+    auto EvalBegin = chrono::steady_clock::now();
+    if (Remote)
+      Remote->evaluate(Batch, Misses, Results, Failed, completeRow);
+    else if (Pool)
+      Pool->evaluate(Batch, Misses, Results, Failed, completeRow);
+    else if (BatchObjective)
+      evaluateMissSlices(NumRows);
+    else if (Workers)
+      Workers->evaluate(Misses.size(), EvalMissFn, Scenario.Priority);
+    else
+      Evaluator->evaluate(Misses.size(), EvalMissFn);
+    // Speculative results of the batch are waited for once the rest of it
+    // runs, and the ones that failed evaluated again
+    if (!Awaited.empty()) {
+      vector<size_t> FirstMisses, Retries;
+      FirstMisses.swap(Misses);
+      for (size_t request : Awaited) {
+        for (int param = 0; param < numParams; param++)
+          CacheKey[param] = Batch.get(request, param) + 0.0;
+        if (!Speculator->await(CacheKey.data(), Results, request)) {
+          Retries.push_back(request);
+          continue;
+        }
+        NumSpeculativeHits++;
+        if (EarlyStop && Results.feasibleAt(request))
+          EarlyStop->add(Results, request);
+        completeRow(request);
+      }
+      Misses = Retries;
+      if (!Misses.empty())
+        Workers->evaluate(Misses.size(), EvalMissFn, Scenario.Priority);
+      Misses.insert(Misses.begin(), FirstMisses.begin(), FirstMisses.end());
+    }
+    Stats.EvalMs += elapsedMs(EvalBegin, chrono::steady_clock::now());
+    Stats.NumEvaluations += Misses.size();
+    Stats.NumRounds +=
+        (Misses.size() + Stats.NumWorkers - 1) / Stats.NumWorkers;
+    if (Reorder.getNumEmitted() != NumRows)
+      fatalError("Configurations of the batch were not evaluated");
+    // Worker processes report the medians only
+    if (Repeats > 1 && !Pool)
+      for (size_t request : Misses)
+        Trace.addMeasurement(Iteration, request,
+                             &Spread[request * NumObjectives]);
+    if (UseCache) {
+      // Failed and stopped evaluations are retried when they are requested
+      // again
+      for (size_t request : Misses) {
+        if (Failed[request] || (EarlyStop && EarlyStop->isStopped(request)))
+          continue;
+        for (int param = 0; param < numParams; param++)
+          CacheKey[param] = Batch.get(request, param) + 0.0;
+        for (size_t out = 0; out < NumOutputs; out++)
+          CacheOutputs[out] = Results.at(request, out);
+        Cache.insert(CacheKey.data(), CacheOutputs.data(),
+                     Results.feasibleAt(request));
+      }
+      Cache.flush();
+    }
+    if (Speculator)
+      Speculator->addSamples(Batch, Results, Failed);
+    return size_t(count(Failed.begin(), Failed.end(), 1));
+  };
+  // Appends row Row of Batch and Results as a line, without its '\n', of
+  // a samples csv with SampleHeader
+  auto appendSampleRow = [&](HMResponseWriter &Out, size_t Row,
+                             double Timestamp) {
+    for (int param = 0; param < numParams; param++) {
+      double V = Batch.get(Row, param);
+      if (InParams[param]->getType() == Categorical) {
+        const vector<string> &Categories = InParams[param]->getCategories();
+        if (!(V >= 0 && V < Categories.size()))
+          fatalError("Category index " + HMInputParam::formatValue(V) +
+                     " out of range for parameter " +
+                     InParams[param]->getName());
+        Out.append(Categories[size_t(V)]);
+      } else
+        Out.appendNumber(V);
+      Out.append(',');
+    }
+    for (size_t obj = 0; obj < NumObjectives; obj++) {
+      Out.appendNumber(Results.objective(obj)[Row]);
+      Out.append(',');
+    }
+    if (Scenario.Predictor)
+      Out.append(Results.feasible()[Row] ? "1," : "0,");
+    for (size_t metric = 0; metric < NumMetrics; metric++) {
+      Out.appendNumber(Results.metric(metric)[Row]);
+      Out.append(',');
+    }
+    Out.appendNumber(Timestamp);
+  };
+  // Logs the first NumRows rows of the batch to the checkpoint
+  auto checkpointBatch = [&](size_t NumRows) {
+    double Timestamp =
+        ResumedTimestamp + elapsedMs(RunStart, chrono::steady_clock::now());
+    for (size_t Row = 0; Row < NumRows; Row++) {
+      CheckpointRow.clear();
+      appendSampleRow(CheckpointRow, Row, Timestamp);
+      Checkpoint.append(CheckpointRow.data(), Timestamp);
+    }
+    Checkpoint.commit();
+  };
+
+  // Launch HyperMapper, or connect to one started separately
+  unique_ptr<HMTransport> HyperMapper;
+  if (Session) {
+    HyperMapper = Session->openStudy(JSonFileNameStr);
+  } else if (!Connect.empty()) {
+    HM_LOG(LogLevel, HMLogSummary,
+           "Start HyperMapper with: hypermapper.py " << JSonFileNameStr
+               << " --listen " << Connect << endl);
+    HyperMapper =
+        connectHyperMapper(Connect, Scenario.ConnectTimeout, LogLevel);
+  } else {
+    string cmd = Scenario.ServerCommand;
+    if (cmd.empty()) {
+      cmd = "python3 ";
+      cmd += getenv("HYPERMAPPER_HOME");
+      cmd += "/scripts/hypermapper.py";
+    }
+    cmd += " " + JSonFileNameStr;
+
+    HM_LOG(LogLevel, HMLogSummary, "Executing command: " << cmd << endl);
+    HyperMapper = spawnHyperMapper(cmd);
+  }
+  // The protocol loop stays off the workers' cores. HyperMapper is started
+  // before it is pinned, so its model fitting is not confined to them.
+  HMThreadPinning ProtocolPinning(ProtocolCPUs);
+  if (!ProtocolCPUs.empty())
+    HM_LOG(LogLevel, HMLogSummary,
+           "Protocol thread on CPUs " << formatCPUSet(ProtocolCPUs) << endl);
+  int ToHyperMapper = HyperMapper->getWriteFD();
+
+  HMLineReader Reader(HyperMapper->getReadFD());
+
+  string_view Line;
+  vector<string_view> RequestLines;
+  HMHeaderMap InputParamsMap(InParams);
+  HMValueParser ValueParser(InParams);
+  string ResponseHeader;
+  HMResponseWriter Response;
+  // Streamed text replies, at most one write per millisecond unless 64 KB
+  // are pending
+  HMReplyStream ReplyStream(chrono::milliseconds(1), 1 << 16, LogLevel);
+  HMMappedFile RequestFile;
+  // Names of the reply columns after the inputs: objectives, feasibility
+  // and extra metrics
+  string OutputNames;
+  for (auto &objString : Objectives)
+    OutputNames += objString + ",";
+  if (Scenario.Predictor)
+    OutputNames += "Valid,";
+  for (auto &metricString : Scenario.Metrics)
+    OutputNames += metricString + ",";
+  OutputNames.pop_back();
+  // Appends the reply row of configuration Row to Out, its echoed values
+  // followed by its outputs
+  auto appendTextRow = [&](HMResponseWriter &Out, size_t Row) {
+    Out.append(stripLineEnd(RequestLines[Row]));
+    for (size_t obj = 0; obj < NumObjectives; obj++) {
+      Out.append(',');
+      Out.appendNumber(Results.objective(obj)[Row]);
+    }
+    if (Scenario.Predictor) {
+      Out.append(',');
+      Out.append(Results.feasible()[Row] ? '1' : '0');
+    }
+    for (size_t metric = 0; metric < NumMetrics; metric++) {
+      Out.append(',');
+      Out.appendNumber(Results.metric(metric)[Row]);
+    }
+    Out.append('\n');
+  };
+  // Called for every row in request order once it is done. A failed row
+  // reports the worst value seen so far for every objective.
+  auto finishRow = [&](size_t Row) {
+    for (size_t obj = 0; obj < NumObjectives; obj++) {
+      double &Value = Results.at(Row, obj);
+      if (Failed[Row])
+        Value = WorstObjectives[obj] == -HUGE_VAL ? 0 : WorstObjectives[obj];
+      else
+        // max() keeps its first argument when the value is NaN
+        WorstObjectives[obj] = max(WorstObjectives[obj], Value);
+    }
+  };
+  // Map header columns to InParams, only redone when the header changes
+  auto receiveHeader = [&](string_view HeaderLine) {
+    HM_LOG(LogLevel, HMLogTrace, "Recieved: " << HeaderLine);
+    if (InputParamsMap.update(HeaderLine)) {
+      ResponseHeader.assign(stripLineEnd(HeaderLine));
+      ResponseHeader += "," + OutputNames + "\n";
+    }
+  };
+
+  try {
+    if (!DOEPath.empty()) {
+      // Evaluated while HyperMapper starts
+      auto DOEStart = chrono::steady_clock::now();
+      size_t NumDOE = generateLatinHypercube(InParams, Scenario.NumSamples,
+                                             Scenario.DOESeed, Batch);
+      Results.reset(NumDOE, NumObjectives, NumMetrics);
+      Failed.assign(NumDOE, 0);
+      Reorder.reset(NumDOE, finishRow, [] {});
+      size_t DOEFailed = evaluateBatch(NumDOE, -1);
+      NumFailed += DOEFailed;
+      if (Scenario.Checkpoint)
+        checkpointBatch(NumDOE);
+      double Timestamp =
+          ResumedTimestamp + elapsedMs(RunStart, chrono::steady_clock::now());
+      Response.clear();
+      Response.append(SampleHeader + "\n");
+      for (size_t Row = 0; Row < NumDOE; Row++) {
+        appendSampleRow(Response, Row, Timestamp);
+        Response.append('\n');
+      }
+      auto DOEEnd = chrono::steady_clock::now();
+      bool Read = writeResumePipe(DOEPath, Response.data(),
+                                  HyperMapper->getReadFD());
+      unlink(DOEPath.c_str());
+      HM_LOG(LogLevel, HMLogSummary,
+             "Design of experiments: " << NumDOE << " samples, eval "
+                 << elapsedMs(DOEStart, DOEEnd) << " ms, wait "
+                 << elapsedMs(DOEEnd, chrono::steady_clock::now()) << " ms"
+                 << (DOEFailed ? ", " + to_string(DOEFailed) + " failed"
+                               : string())
+                 << (Read ? string() : ", not read by HyperMapper") << "\n");
+    }
+
+    // Loop that communicates with HyperMapper
+    int i = 0;
+    while (true) {
+      auto WaitStart = chrono::steady_clock::now();
+      if (!Reader.readLine(Line))
+        fatalError("HyperMapper exited unexpectedly!");
+      // Speculative evaluations in flight go on alongside the batch
+      if (Speculator) {
+        Speculator->cancel();
+        Speculator->collect(Cache);
+      }
+      HM_LOG(LogLevel, HMLogTrace, "Iteration: " << i << endl);
+      HM_LOG(LogLevel, HMLogTrace, "Recieved: " << Line);
+      // Receiving Num Requests
+      if (Line == "End of HyperMapper\n") {
+        HM_LOG(LogLevel, HMLogSummary, "Hypermapper completed!\n");
+        break;
+      }
+      // HyperMapper offers the binary protocol before its first request
+      // when binary_protocol is set in the scenario
+      if (Line == "Protocol binary 1\n") {
+        writeAll(ToHyperMapper, Scenario.BinaryProtocol
+                                           ? "Protocol binary 1\n"
+                                           : "Protocol text\n");
+        continue;
+      }
+      auto ParseStart = chrono::steady_clock::now();
+      if (i > 0) {
+        Stats.TurnaroundMs += elapsedMs(WaitStart, ParseStart);
+        Stats.NumTurnarounds++;
+      }
+      int numRequests;
+      string_view RequestFilePath;
+      bool FileRequest = false;
+      bool BinaryRequest = false;
+      if (parseRequestLine(Line, numRequests)) {
+        // Receiving input param names
+        if (!Reader.readLine(Line))
+          fatalError("HyperMapper exited unexpectedly!");
+        receiveHeader(Line);
+        // Receive the whole batch before evaluating any of it. The lines
+        // stay in the reader's buffer and are echoed from there.
+        if (!Reader.readLines(numRequests, RequestLines))
+          fatalError("HyperMapper exited unexpectedly!");
+      } else if (parseFileRequestLine(Line, numRequests, RequestFilePath)) {
+        // The batch is in a csv file: header line followed by one line per
+        // request. The lines are used in place in the mapped file.
+        FileRequest = true;
+        string Path(RequestFilePath);
+        RequestFile.open(Path);
+        string_view Data = RequestFile.data();
+        if (!nextLine(Data, Line))
+          fatalError("Empty request file: " + Path);
+        receiveHeader(Line);
+        RequestLines.resize(numRequests);
+        for (int request = 0; request < numRequests; request++)
+          if (!nextLine(Data, RequestLines[request]))
+            fatalError("Missing requests in file: " + Path);
+      } else if (parseBinaryRequestLine(Line, numRequests)) {
+        // Header line, payload size and one column of little-endian doubles
+        // per parameter in header order
+        BinaryRequest = true;
+        if (!Reader.readLine(Line))
+          fatalError("HyperMapper exited unexpectedly!");
+        receiveHeader(Line);
+        string_view Payload;
+        if (!Reader.readBytes(sizeof(uint64_t), Payload))
+          fatalError("HyperMapper exited unexpectedly!");
+        uint64_t PayloadSize = readLE64(Payload, 0);
+        if (PayloadSize != uint64_t(numRequests) * numParams * sizeof(double))
+          fatalError("Unexpected binary payload size: " +
+                     to_string(PayloadSize));
+        if (!Reader.readBytes(PayloadSize, Payload))
+          fatalError("HyperMapper exited unexpectedly!");
+        Batch.resize(numRequests, numParams);
+        for (int param = 0; param < numParams; param++) {
+          int ParamIdx = InputParamsMap[param];
+          size_t NumCategories = ValueParser.getNumCategories(ParamIdx);
+          size_t ColumnOffset = size_t(param) * numRequests * sizeof(double);
+          double *Column = Batch.column(ParamIdx);
+          for (int request = 0; request < numRequests; request++) {
+            double Value = readLEDouble(
+                Payload, ColumnOffset + request * sizeof(double));
+            // Categorical values are sent as the index of the category
+            if (NumCategories && !(Value >= 0 && Value < NumCategories &&
+                                   Value == nearbyint(Value)))
+              fatalError("Categorical index out of range for " +
+                         InParams[ParamIdx]->getName());
+            Column[request] = Value;
+          }
+        }
+      } else {
+        fatalError("Unexpected message received: " + string(Line));
+      }
+      if (!BinaryRequest)
+        Batch.resize(numRequests, numParams);
+      size_t ResponseSize = ResponseHeader.size();
+      for (int request = 0; !BinaryRequest && request < numRequests;
+           request++) {
+        // Receiving paramter values
+        string_view ValuesLine = RequestLines[request];
+        HM_LOG(LogLevel, HMLogTrace, "Received: " << ValuesLine);
+        ResponseSize += ValuesLine.size();
+        if (Scenario.TypedParams) {
+          if (!Scenario.TypedParams->parseRow(ValuesLine, InputParamsMap,
+                                              Batch, request))
+            fatalError("Malformed parameter values received: " +
+                       string(ValuesLine));
+          continue;
+        }
+        HMLineTokenizer Values(ValuesLine);
+        string_view ParamValStr;
+        for (int param = 0; param < numParams; param++) {
+          int ParamIdx = InputParamsMap[param];
+          if (!Values.next(ParamValStr) ||
+              !ValueParser.parse(ParamIdx, ParamValStr,
+                                 Batch.at(request, ParamIdx)))
+            fatalError("Malformed parameter values received: " +
+                       string(ValuesLine));
+        }
+      }
+      auto EvalStart = chrono::steady_clock::now();
+      Trace.add(HMPhaseWait, WaitStart, ParseStart, i, numRequests);
+      Trace.add(HMPhaseParse, ParseStart, EvalStart, i, numRequests);
+      Results.reset(numRequests, NumObjectives, NumMetrics);
+      Failed.assign(numRequests, 0);
+      // Text replies on the pipe are streamed: the header is sent once the
+      // evaluation starts and rows in request order as soon as they and
+      // every row before them are done, so HyperMapper reads them while the
+      // rest of the batch is evaluated. Rows done in quick succession are
+      // sent together by ReplyStream. Other replies are assembled once the
+      // batch is done.
+      bool StreamReply = !FileRequest && !BinaryRequest;
+      Response.clear();
+      if (StreamReply)
+        ReplyStream.start(ToHyperMapper, ResponseHeader);
+      Reorder.reset(
+          numRequests,
+          [&](size_t Row) {
+            finishRow(Row);
+            if (StreamReply)
+              ReplyStream.append(
+                  [&](HMResponseWriter &Out) { appendTextRow(Out, Row); });
+          },
+          [&] {
+            // The last rows are sent by finish() once the batch returns
+            if (StreamReply && Reorder.getNumEmitted() < size_t(numRequests))
+              ReplyStream.flush();
+          });
+      size_t StoppedBefore = EarlyStop ? EarlyStop->getNumStopped() : 0;
+      size_t BatchFailed = evaluateBatch(numRequests, i);
+      NumFailed += BatchFailed;
+      size_t BatchStopped =
+          EarlyStop ? EarlyStop->getNumStopped() - StoppedBefore : 0;
+      auto ReplyStart = chrono::steady_clock::now();
+      // Assemble the response rows in request order
+      const uint8_t *Feasible = Results.feasible();
+      size_t NumReplyColumns = NumOutputs + Scenario.Predictor;
+      if (StreamReply) {
+        // Already sent
+      } else if (BinaryRequest) {
+        // One column of doubles per objective, the feasibility flag and the
+        // extra metrics
+        Response.reserve(64 + OutputNames.size() +
+                         NumReplyColumns * numRequests * sizeof(double));
+        Response.append("BResponse " + to_string(numRequests) + "\n");
+        Response.append(OutputNames);
+        Response.append('\n');
+        Response.appendLE(
+            uint64_t(NumReplyColumns * numRequests * sizeof(double)));
+        for (size_t obj = 0; obj < NumObjectives; obj++)
+          for (int request = 0; request < numRequests; request++)
+            Response.appendLE(Results.objective(obj)[request]);
+        if (Scenario.Predictor)
+          for (int request = 0; request < numRequests; request++)
+            Response.appendLE(Feasible[request] ? 1.0 : 0.0);
+        for (size_t metric = 0; metric < NumMetrics; metric++)
+          for (int request = 0; request < numRequests; request++)
+            Response.appendLE(Results.metric(metric)[request]);
+      } else {
+        const size_t MaxNumberChars = 25;
+        ResponseSize += numRequests * NumReplyColumns * MaxNumberChars;
+        Response.reserve(ResponseSize);
+        Response.append(ResponseHeader);
+        for (int request = 0; request < numRequests; request++)
+          appendTextRow(Response, request);
+        HM_LOG(LogLevel, HMLogTrace, "Response:\n" << Response.data());
+      }
+      auto FormatEnd = chrono::steady_clock::now();
+      if (FileRequest) {
+        // Results go to <file>.out in one write, then HyperMapper is told
+        // they are ready
+        string OutPath = string(RequestFilePath) + ".out";
+        int OutFD = open(OutPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (OutFD < 0)
+          fatalError("Unable to open file: " + OutPath);
+        try {
+          writeAll(OutFD, Response.data());
+        } catch (...) {
+          close(OutFD);
+          throw;
+        }
+        close(OutFD);
+        RequestFile.close();
+        writeAll(ToHyperMapper, "Ready " + OutPath + "\n");
+      } else if (StreamReply) {
+        // The rows still held back
+        ReplyStream.finish();
+      } else {
+        writeAll(ToHyperMapper, Response.data());
+      }
+      auto ReplyEnd = chrono::steady_clock::now();
+      if (Scenario.Checkpoint) {
+        // Logged once HyperMapper has the batch, so syncing overlaps with
+        // its next iteration
+        checkpointBatch(numRequests);
+      }
+      auto CheckpointEnd = chrono::steady_clock::now();
+      Trace.add(HMPhaseEval, EvalStart, ReplyStart, i, numRequests);
+      Trace.add(HMPhaseFormat, ReplyStart, FormatEnd, i, numRequests);
+      Trace.add(HMPhaseWrite, FormatEnd, ReplyEnd, i, numRequests);
+      if (Scenario.Checkpoint)
+        Trace.add(HMPhaseCheckpoint, ReplyEnd, CheckpointEnd, i, numRequests);
+      HM_LOG(LogLevel, HMLogSummary,
+             "Iteration " << i << ": " << numRequests << " requests, wait "
+                          << elapsedMs(WaitStart, ParseStart) << " ms, parse "
+                          << elapsedMs(ParseStart, EvalStart) << " ms, eval "
+                          << elapsedMs(EvalStart, ReplyStart) << " ms, reply "
+                          << elapsedMs(ReplyStart, ReplyEnd) << " ms"
+                          << (Scenario.Checkpoint
+                                  ? ", checkpoint " +
+                                        to_string(elapsedMs(ReplyEnd,
+                                                            CheckpointEnd)) +
+                                        " ms"
+                                  : string())
+                          << (UseCache
+                                  ? ", " + to_string(numRequests -
+                                                     Misses.size()) +
+                                        " cached"
+                                  : string())
+                          << (Speculator
+                                  ? ", " + to_string(NumSpeculativeHits) +
+                                        " speculative hits"
+                                  : string())
+                          << (BatchFailed
+                                  ? ", " + to_string(BatchFailed) + " failed"
+                                  : string())
+                          << (BatchStopped
+                                  ? ", " + to_string(BatchStopped) +
+                                        " stopped early"
+                                  : string())
+                          << "\n");
+      // Use the workers until HyperMapper sends its next request
+      if (Speculator)
+        Speculator->start(Cache, runSpeculation);
+      i++;
+    }
+  } catch (...) {
+    // Do not leave HyperMapper behind when the study is aborted
+    HyperMapper->close(/*Abort=*/true);
+    if (!DOEPath.empty())
+      unlink(DOEPath.c_str());
+    throw;
+  }
+
+  HyperMapper->close();
+
+  if (UseCache)
+    HM_LOG(LogLevel, HMLogSummary,
+           "Evaluation cache: " << Cache.getHits() << " hits, "
+                                << Cache.getMisses() << " misses, "
+                                << Cache.size() << " configurations" << endl);
+  if (Speculator) {
+    size_t Evaluated = Speculator->getNumEvaluated();
+    HM_LOG(LogLevel, HMLogSummary,
+           "Speculation: " << Evaluated << " evaluated, "
+                           << Speculator->getNumHits() << " hits ("
+                           << (Evaluated ? 100 * Speculator->getNumHits() /
+                                               Evaluated
+                                         : 0)
+                           << "%)" << endl);
+  }
+  Cache.close();
+  Checkpoint.close();
+  if (Pool)
+    HM_LOG(LogLevel, HMLogSummary,
+           "Worker processes: " << NumFailed << " failed evaluations, "
+                                << Pool->getNumTimeouts() << " timeouts, "
+                                << Pool->getNumCrashes() << " crashes"
+                                << endl);
+
+  if (EarlyStop)
+    HM_LOG(LogLevel, HMLogSummary,
+           "Early stopping: " << EarlyStop->getNumStopped()
+                              << " evaluations stopped of "
+                              << Stats.NumEvaluations << ", saving "
+                              << EarlyStop->getSavedBudget()
+                              << " evaluation budgets" << endl);
+  if (Repeats > 1) {
+    string SpreadSummary;
+    // Worker processes do not report the spread
+    for (size_t obj = 0; obj < NumObjectives && !Pool; obj++) {
+      const HMTrace::SpreadStats &S = Trace.getSpread(obj);
+      SpreadSummary += ", " + Objectives[obj] + " CV mean " +
+                       to_string(S.Count ? S.TotalCV / S.Count : 0) +
+                       " max " + to_string(S.MaxCV);
+    }
+    HM_LOG(LogLevel, HMLogSummary,
+           "Repeated measurements: " << Repeats << " per configuration"
+                                     << SpreadSummary << endl);
+  }
+  string TimeSummary;
+  for (int P = 0; P < HMNumPhases; P++)
+    if (Trace.getStats(HMPhase(P)).Count)
+      TimeSummary += string(TimeSummary.empty() ? "" : ", ") +
+                     getPhaseName(HMPhase(P)) + " " +
+                     to_string(Trace.getTotalMs(HMPhase(P))) + " ms";
+  HM_LOG(LogLevel, HMLogSummary, "Time spent: " << TimeSummary << endl);
+  if (Scenario.Trace) {
+    string Prefix = string(fs::current_path()) + "/" +
+                    Scenario.OutputFoldername + "/" + Scenario.AppName;
+    Trace.writeSummary(Prefix + "_timing.json");
+    Trace.writeChromeTrace(Prefix + "_trace.json");
+    HM_LOG(LogLevel, HMLogSummary,
+           "Timing written to " << Prefix << "_timing.json and "
+                                << Prefix << "_trace.json" << endl);
+  }
+
+  if (Scenario.ComputePareto)
+    computePareto(Scenario, LogLevel);
+}
+
+void HyperMapperClient::autoTune(const HMScenario &Scenario,
+                                 const HMObjectiveFn &Objective,
+                                 const HMBatchObjectiveFn *BatchObjective) {
+  HMLogLevel LogLevel =
+      parseLogLevel(getenv("HM_LOG_LEVEL"), Scenario.LogLevel);
+  // The first iterations of the study with a batch per round of the
+  // workers. They are logged like a checkpoint and the study resumes from
+  // the log, so HyperMapper counts the pilot's samples and iterations as
+  // its own. Without Checkpoint the log only serves this and is removed.
+  string CheckpointPath = getCheckpointPath(Scenario);
+  if (!Scenario.Checkpoint)
+    unlink(CheckpointPath.c_str());
+  HMScenario Pilot = Scenario;
+  Pilot.NumIterations = Scenario.AutoTuneIterations;
+  Pilot.AutoTuneIterations = 0;
+  if (Scheduler)
+    Pilot.EvaluationsPerIteration = Scheduler->getNumWorkers();
+  else if (Scenario.NumCPUs > 0)
+    Pilot.EvaluationsPerIteration = Scenario.NumCPUs;
+  else
+    Pilot.EvaluationsPerIteration = max(1u, thread::hardware_concurrency());
+  Pilot.Speculate = 0;
+  Pilot.Checkpoint = true;
+  Pilot.Trace = false;
+  Pilot.ComputePareto = false;
+  HM_LOG(LogLevel, HMLogSummary,
+         "Auto-tune: pilot of the first " << Pilot.NumIterations
+                                      << " iterations with batches of "
+                                      << Pilot.EvaluationsPerIteration
+                                      << endl);
+  runStudy(Pilot, Objective, BatchObjective);
+
+  HMScenario Tuned = Scenario;
+  Tuned.AutoTuneIterations = 0;
+  Tuned.Checkpoint = true;
+  HMAutoTuneChoice Choice = chooseBatchSize(Stats);
+  if (Choice.Throughput > 0) {
+    Tuned.EvaluationsPerIteration = Choice.EvaluationsPerIteration;
+    // Shared workers and agents are not this study's to size
+    if (!Scheduler && Scenario.Agents.empty())
+      Tuned.NumCPUs = Choice.NumWorkers;
+    HM_LOG(LogLevel, HMLogSummary,
+           "Auto-tune: evaluation " << Choice.EvalMs << " ms, turnaround "
+               << Choice.TurnaroundMs << " ms, "
+               << Tuned.EvaluationsPerIteration
+               << " configurations per iteration on " << Choice.NumWorkers
+               << " workers, expecting " << Choice.Throughput
+               << " configurations/s" << endl);
+  } else {
+    HM_LOG(LogLevel, HMLogSummary,
+           "Auto-tune: the pilot study timed no batches, keeping the "
+           "scenario"
+               << endl);
+  }
+  runStudy(Tuned, Objective, BatchObjective);
+  if (!Scenario.Checkpoint)
+    unlink(CheckpointPath.c_str());
+}
+
+void HyperMapperClient::computePareto(const HMScenario &Scenario,
+                                      HMLogLevel LogLevel) {
+  string OutputDir =
+      string(fs::current_path()) + "/" + Scenario.OutputFoldername + "/";
+  string DataFile = OutputDir + Scenario.AppName + "_output_data.csv";
+  string ParetoFile = OutputDir + Scenario.AppName + "_output_pareto.csv";
+  HM_LOG(LogLevel, HMLogSummary,
+         "Computing the Pareto of " << DataFile << endl);
+  auto Start = chrono::steady_clock::now();
+  size_t ParetoSize =
+      writeParetoFile(DataFile, ParetoFile, Scenario.Objectives,
+                      Scenario.Predictor ? "Valid" : "", "1");
+  HM_LOG(LogLevel, HMLogSummary,
+         "Pareto of size " << ParetoSize << " written to " << ParetoFile
+                           << " in "
+                           << elapsedMs(Start, chrono::steady_clock::now())
+                           << " ms" << endl);
+}
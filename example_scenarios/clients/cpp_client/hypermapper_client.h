@@ -0,0 +1,263 @@
+#ifndef HM_HYPERMAPPER_CLIENT_H
+#define HM_HYPERMAPPER_CLIENT_H
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cpp_client.h"
+#include "hm_batch.h"
+#include "hm_evaluator.h"
+#include "hm_log.h"
+
+class HMHeaderMap;
+
+// Parameters of a scenario declared with an HMSpace, see hm_space.h. Holds
+// the parameters HMScenario::InParams points to and parses request rows
+// with code specialized for their types.
+class HMTypedParams {
+public:
+  virtual ~HMTypedParams() = default;
+
+  // Parses the fields of the request row Line, in the column order of
+  // Columns, into row Row of Batch. Returns false if a field is missing or
+  // not a value of its parameter.
+  virtual bool parseRow(std::string_view Line, const HMHeaderMap &Columns,
+                        HMBatch &Batch, size_t Row) const = 0;
+
+  size_t size() const { return Params.size(); }
+  HMInputParam &operator[](size_t Idx) { return Params[Idx]; }
+
+protected:
+  std::vector<HMInputParam> Params;
+};
+
+// Description of one HyperMapper optimization study
+struct HMScenario {
+  // Name of application
+  std::string AppName;
+  // Name of output folder, relative to the current directory
+  std::string OutputFoldername = "outdata";
+  // Number of HP iterations
+  int NumIterations = 20;
+  // Number of HP design-of-experiment samples
+  int NumSamples = 10;
+  // Configurations HyperMapper requests per optimization iteration
+  int EvaluationsPerIteration = 1;
+  // Runs the first this many iterations as a pilot and picks
+  // EvaluationsPerIteration and NumCPUs for the rest of the study from its
+  // evaluation latency and HyperMapper turnaround, see hm_autotune.h. The
+  // study resumes from the pilot's samples. 0 disables it.
+  int AutoTuneIterations = 0;
+  // Generates and evaluates the Latin hypercube design of experiments in
+  // the client while HyperMapper starts, instead of waiting for HyperMapper
+  // to send it. DOESeed selects the sample.
+  bool ClientDOE = false;
+  uint64_t DOESeed = 0;
+  // Enables/disables the feasibility predictor
+  bool Predictor = true;
+  // Number of parallel evaluations per request batch (0 = all cores)
+  int NumCPUs = 0;
+  // Pins the evaluation threads to physical cores or NUMA nodes and the
+  // protocol thread to a core of its own, see hm_affinity.h
+  HMPlacement Placement = HMPlaceAny;
+  // Evaluates every configuration this many times back to back on its
+  // worker thread and reports the median of every objective and metric,
+  // and the feasibility most evaluations reported. The spread of the
+  // objectives goes to the timing summary. Agents evaluate once.
+  int Repeats = 1;
+  // Stops evaluations whose interim estimates, reported with
+  // HMObjective::reportInterim, are confidently dominated by the
+  // configurations evaluated in full so far, see hm_early_stop.h. Stopped
+  // configurations report their last estimate and the fidelity it reached
+  // in a Fidelity metric added to Metrics, 1 for complete evaluations. An
+  // estimate at fidelity F is taken to improve by at most EarlyStopMargin *
+  // (1 - F) of its value, and estimates below EarlyStopMinFidelity never
+  // stop. Evaluations in worker processes, on agents or repeated are not
+  // stopped.
+  bool EarlyStopping = false;
+  double EarlyStopMargin = 0.1;
+  double EarlyStopMinFidelity = 0.1;
+  // Share of the workers of a shared HMScheduler relative to the other
+  // studies with work, see hm_scheduler.h
+  unsigned Priority = 1;
+  // Evaluates in forked worker processes instead of threads, so hanging or
+  // crashing evaluations can be killed
+  bool WorkerProcesses = false;
+  // Wall-clock limit of one evaluation in seconds with WorkerProcesses, 0
+  // for none. Evaluations that exceed it are reported infeasible.
+  double EvalTimeout = 0;
+  // host:port of hm_agent evaluation agents. When set, configurations are
+  // evaluated on the agents instead of locally.
+  std::vector<std::string> Agents;
+  // Names of the optimization objectives
+  std::vector<std::string> Objectives;
+  // Names of extra metrics reported after the objectives. HyperMapper
+  // ignores columns it does not know, so they are informational only.
+  std::vector<std::string> Metrics;
+  // Input parameters, the objective receives their values in this order
+  std::vector<HMInputParam *> InParams;
+  // Set by HMSpace::describe, shared by the copies of the scenario.
+  // InParams must not be changed while it is set.
+  std::shared_ptr<HMTypedParams> TypedParams;
+  // Batches with at least this many configurations are exchanged through a
+  // csv file (FRequest) instead of the pipe, 0 always uses the pipe
+  int FileProtocolBatchSize = 0;
+  // Exchanges batches as columns of little-endian doubles instead of text
+  bool BinaryProtocol = false;
+  // Reuses the results of configurations evaluated before, in this run or
+  // earlier runs of the same scenario, instead of calling the objective.
+  // Only valid for deterministic objectives.
+  bool CacheEvaluations = false;
+  // Evaluates up to this many neighbours of the best configurations while
+  // HyperMapper fits its model, 0 to disable. Their results go to the
+  // evaluation cache, which this enables. The next request does not wait
+  // for them unless it asks for a configuration still being evaluated.
+  size_t Speculate = 0;
+  // Logs every answered configuration to <AppName>_checkpoint.csv in the
+  // output folder. A run started while the log holds configurations
+  // resumes the study from them.
+  bool Checkpoint = false;
+  // Writes the time spent in each phase of the protocol loop to
+  // <AppName>_timing.json and a Chrome trace of every batch to
+  // <AppName>_trace.json in the output folder
+  bool Trace = false;
+  // Writes the Pareto front of the samples once HyperMapper is done
+  bool ComputePareto = true;
+  // Shell command run in place of HyperMapper, e.g. a mock server, with the
+  // scenario file appended. Empty runs
+  // python3 $HYPERMAPPER_HOME/scripts/hypermapper.py.
+  std::string ServerCommand;
+  // Address HyperMapper listens on, unix:<path> or <host>:<port>, when it is
+  // started separately with --listen instead of by the client. Overridden
+  // by the HM_CONNECT environment variable.
+  std::string Connect;
+  // Seconds to keep retrying while nothing listens on Connect yet
+  double ConnectTimeout = 60;
+  // Amount of output, overridden by the HM_LOG_LEVEL environment variable
+  // (off, summary or trace)
+  HMLogLevel LogLevel = HMLogTrace;
+};
+
+// Hash of everything that determines what a configuration of Scenario
+// evaluates to: the parameters with their types and values and the output
+// names. The AppName is left out, so the studies of one scenario under
+// different names share its agents.
+uint64_t getScenarioSignature(const HMScenario &Scenario);
+
+// Timings of a run, to size the batches of later runs
+struct HMRunStats {
+  // Workers evaluating the batches
+  unsigned NumWorkers = 0;
+  // Evaluated configurations, cache hits excluded, rounds of the workers
+  // they took, ceil(configurations / workers) per batch, and their time
+  size_t NumEvaluations = 0;
+  size_t NumRounds = 0;
+  double EvalMs = 0;
+  // Time HyperMapper took from a reply to its next request
+  size_t NumTurnarounds = 0;
+  double TurnaroundMs = 0;
+};
+
+// Read-only view of one configuration handed to the objective function
+class HMConfig {
+private:
+  const std::vector<HMInputParam *> &Params;
+  const HMBatch &Batch;
+  size_t Row;
+
+public:
+  HMConfig(const std::vector<HMInputParam *> &_Params, const HMBatch &_Batch,
+           size_t _Row)
+      : Params(_Params), Batch(_Batch), Row(_Row) {}
+
+  size_t size() const { return Params.size(); }
+
+  // Value of the parameter at position Idx of HMScenario::InParams, rounded
+  // for real parameters. Categorical parameters give their numeric value,
+  // or the category index for string categories.
+  int getInt(size_t Idx) const;
+  int operator[](size_t Idx) const { return getInt(Idx); }
+
+  // Value of the parameter at position Idx as a double
+  double getReal(size_t Idx) const;
+
+  // Category of the categorical parameter at position Idx
+  const std::string &getCategory(size_t Idx) const;
+  size_t getCategoryIndex(size_t Idx) const { return Batch.get(Row, Idx); }
+
+  // Value of the parameter at position Idx as stored in HMBatch: the number,
+  // or the category index for categorical parameters
+  double getValue(size_t Idx) const { return Batch.get(Row, Idx); }
+
+  const HMInputParam &getParam(size_t Idx) const { return *Params[Idx]; }
+
+  // Position of the parameter with the given name
+  size_t getIndex(const std::string &Name) const;
+
+  // Value of the parameter with the given name
+  int getVal(const std::string &Name) const { return getInt(getIndex(Name)); }
+};
+
+// The objective stores its results in the HMObjective it receives. It is
+// called concurrently from the evaluator threads, so it must not modify
+// shared state without synchronization.
+using HMObjectiveFn = std::function<void(const HMConfig &, HMObjective &)>;
+
+// Batch objectives evaluate a whole slice of configurations per call, for
+// objectives cheap enough that a call per configuration would dominate.
+// Slices of one batch are evaluated concurrently from the evaluator
+// threads.
+using HMBatchObjectiveFn = std::function<void(HMBatchSlice &)>;
+
+// Client that runs HyperMapper in client-server mode and answers its
+// requests through a user supplied objective. A client can run any number
+// of studies one after another, reusing its evaluation threads.
+class HMScheduler;
+class HMSession;
+
+class HyperMapperClient {
+public:
+  HyperMapperClient() = default;
+  // Runs the studies in Session instead of a HyperMapper of their own, and
+  // evaluates on the workers of Scheduler instead of a pool of their own.
+  // Either can be null. Clients sharing them can run in parallel threads.
+  explicit HyperMapperClient(HMSession *_Session,
+                             HMScheduler *_Scheduler = nullptr)
+      : Session(_Session), Scheduler(_Scheduler) {}
+
+  // Writes the JSON scenario for Scenario and returns its path. With a
+  // ResumeDataFile HyperMapper resumes from the samples in that csv file.
+  std::string createScenarioFile(const HMScenario &Scenario,
+                                 HMLogLevel LogLevel = HMLogSummary,
+                                 const std::string &ResumeDataFile = "");
+
+  // Runs a full optimization of Scenario, evaluating every configuration
+  // HyperMapper requests with Objective. Errors are reported by throwing
+  // HMError.
+  void run(const HMScenario &Scenario, const HMObjectiveFn &Objective);
+  // Same with a batch objective. Worker processes, agents and speculative
+  // evaluation call it with one configuration at a time.
+  void run(const HMScenario &Scenario, const HMBatchObjectiveFn &Objective);
+
+  // Timings of the last run
+  const HMRunStats &getRunStats() const { return Stats; }
+
+private:
+  void runStudy(const HMScenario &Scenario, const HMObjectiveFn &Objective,
+                const HMBatchObjectiveFn *BatchObjective);
+  void autoTune(const HMScenario &Scenario, const HMObjectiveFn &Objective,
+                const HMBatchObjectiveFn *BatchObjective);
+  HMEvaluator &getEvaluator(int NumCPUs, HMPlacement Placement);
+  void computePareto(const HMScenario &Scenario, HMLogLevel LogLevel);
+
+  HMSession *Session = nullptr;
+  HMScheduler *Scheduler = nullptr;
+  std::unique_ptr<HMEvaluator> Evaluator;
+  int EvaluatorCPUs = -1;
+  HMRunStats Stats;
+};
+
+#endif
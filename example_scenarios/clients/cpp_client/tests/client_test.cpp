@@ -0,0 +1,774 @@
+// Tests of the client library that need no HyperMapper. Agents are served
+// from a thread of the test on the loopback interface, and runs talk to a
+// HyperMapper played by the test over a Unix socket. Prints every failed
+// check and exits with the number of failures.
+//
+// Usage: client_test
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../cpp_client.h"
+#include "../hm_cache.h"
+#include "../hm_checkpoint.h"
+#include "../hm_early_stop.h"
+#include "../hm_process_pool.h"
+#include "../hm_protocol.h"
+#include "../hm_remote.h"
+#include "../hm_reorder.h"
+#include "../hm_scheduler.h"
+#include "../hm_transport.h"
+#include "../hypermapper_client.h"
+#include "../json.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static int NumFailures = 0;
+
+#define CHECK(Cond)                                                            \
+  do {                                                                         \
+    if (!(Cond)) {                                                             \
+      cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #Cond << endl; \
+      NumFailures++;                                                           \
+    }                                                                          \
+  } while (0)
+
+// Numbers read back from the text HyperMapper writes for them
+static void testFormatValue() {
+  CHECK(HMInputParam::formatValue(0.1) == "0.1");
+  CHECK(HMInputParam::formatValue(2.5) == "2.5");
+  CHECK(HMInputParam::formatValue(-0.3) == "-0.3");
+  CHECK(HMInputParam::formatValue(5) == "5");
+  CHECK(HMInputParam::formatValue(-16) == "-16");
+  CHECK(HMInputParam::formatValue(1e-7) == "1e-07");
+  CHECK(HMInputParam::formatValue(1e-4) == "0.0001");
+  CHECK(HMInputParam::formatValue(5e-4) == "0.0005");
+  CHECK(HMInputParam::formatValue(1e-5) == "1e-05");
+  CHECK(HMInputParam::formatValue(1.5e15) == "1500000000000000.0");
+  CHECK(HMInputParam::formatValue(1e16) == "1e+16");
+  CHECK(HMInputParam::formatValue(123456.789) == "123456.789");
+}
+
+// Fractional numeric categories match the values HyperMapper echoes
+static void testNumericCategories() {
+  HMInputParam Rate("rate", ParamType::Categorical);
+  Rate.setRange({0.1, 0.25, 1, 0.3});
+  vector<string> Expected = {"0.1", "0.25", "1", "0.3"};
+  CHECK(Rate.getCategories() == Expected);
+
+  vector<HMInputParam *> InParams = {&Rate};
+  HMValueParser Parser(InParams);
+  double Value = -1;
+  CHECK(Parser.parse(0, "0.1", Value) && Value == 0);
+  CHECK(Parser.parse(0, "0.3", Value) && Value == 3);
+  CHECK(Parser.parse(0, "1", Value) && Value == 2);
+  CHECK(!Parser.parse(0, "0.10000000000000001", Value));
+
+  // Learning rates HyperMapper writes in fixed notation
+  HMInputParam LearningRate("lr", ParamType::Categorical);
+  LearningRate.setRange({0.0001, 0.001});
+  vector<HMInputParam *> RateParams = {&LearningRate};
+  HMValueParser RateParser(RateParams);
+  CHECK(RateParser.parse(0, "0.0001", Value) && Value == 0);
+  CHECK(RateParser.parse(0, "0.001", Value) && Value == 1);
+
+  HMBatch Batch;
+  Batch.resize(1, 1);
+  Batch.at(0, 0) = 3;
+  HMConfig Config(InParams, Batch, 0);
+  CHECK(Config.getCategory(0) == "0.3");
+  CHECK(Config.getReal(0) == 0.3);
+}
+
+// The studies of --studies run copies of a scenario under other names on
+// the agents of the scenario
+static void testAgentsServeRenamedStudies() {
+  HMInputParam X("x", ParamType::Integer);
+  X.setRange({0, 10});
+  HMScenario Scenario;
+  Scenario.AppName = "agent_test";
+  Scenario.Objectives = {"f1", "f2"};
+  Scenario.InParams = {&X};
+  HMObjectiveFn Objective = [](const HMConfig &Config, HMObjective &Obj) {
+    Obj[0] = Config.getInt(0) + 1;
+    Obj[1] = Config.getInt(0) * 2;
+    Obj.setFeasible(true);
+  };
+  int Port = 20000 + getpid() % 20000;
+  string Address = "127.0.0.1:" + to_string(Port);
+  // Serves until the test exits
+  thread([=] {
+    try {
+      runAgent(Port, 1, Scenario, Objective);
+    } catch (const HMError &E) {
+      cerr << "Agent failed: " << E.what() << endl;
+    }
+  }).detach();
+  // Waits for the agent to listen. It then drops the silent connection.
+  ::close(connectSocket(Address, 10));
+
+  // Both studies connect before either evaluates, which only works if the
+  // agent serves them at the same time
+  mutex Mutex;
+  condition_variable ConnectedCV;
+  int NumConnected = 0;
+  auto runStudy = [&](int i) {
+    HMScenario Study = Scenario;
+    Study.AppName += "_" + to_string(i);
+    try {
+      HMRemotePool Pool({Address}, getScenarioSignature(Study), 1, 2, 0,
+                        HMLogOff);
+      {
+        unique_lock<mutex> Lock(Mutex);
+        NumConnected++;
+        ConnectedCV.notify_all();
+        CHECK(ConnectedCV.wait_for(Lock, chrono::seconds(10),
+                                   [&] { return NumConnected == 2; }));
+      }
+      HMBatch Batch;
+      Batch.resize(1, 1);
+      Batch.at(0, 0) = 3 + i;
+      HMResults Results;
+      Results.reset(1, 2, 0);
+      vector<uint8_t> Failed(1, 0);
+      Pool.evaluate(Batch, {0}, Results, Failed);
+      CHECK(!Failed[0]);
+      CHECK(Results.objective(0)[0] == 4 + i);
+      CHECK(Results.objective(1)[0] == 6 + 2 * i);
+    } catch (const HMError &E) {
+      cerr << "Study " << Study.AppName << ": " << E.what() << endl;
+      CHECK(false);
+    }
+  };
+  thread First(runStudy, 0), Second(runStudy, 1);
+  First.join();
+  Second.join();
+
+  // Another scenario is refused
+  HMInputParam Y("y", ParamType::Integer);
+  Y.setRange({0, 20});
+  HMScenario Other = Scenario;
+  Other.InParams = {&Y};
+  bool Refused = false;
+  try {
+    HMRemotePool Pool({Address}, getScenarioSignature(Other), 1, 2, 0,
+                      HMLogOff);
+  } catch (const HMError &) {
+    Refused = true;
+  }
+  CHECK(Refused);
+}
+
+// Free workers go to the batch with the fewest evaluations in flight
+// relative to its weight
+static void testSchedulerFairShare() {
+  HMScheduler Scheduler(3);
+  // Holds every worker until both batches are queued
+  promise<void> Release;
+  shared_future<void> Gate = Release.get_future().share();
+  thread Blocker([&] {
+    HMEvaluator::ObjectiveFn Fn = [&](size_t) { Gate.wait(); };
+    Scheduler.evaluate(3, Fn);
+  });
+  this_thread::sleep_for(chrono::milliseconds(50));
+
+  mutex Mutex;
+  unsigned Running[2] = {0, 0}, MaxRunning[2] = {0, 0};
+  auto runBatch = [&](int B, size_t NumConfigs, unsigned Weight) {
+    HMEvaluator::ObjectiveFn Fn = [&, B](size_t) {
+      {
+        lock_guard<mutex> Lock(Mutex);
+        MaxRunning[B] = max(MaxRunning[B], ++Running[B]);
+      }
+      this_thread::sleep_for(chrono::milliseconds(5));
+      lock_guard<mutex> Lock(Mutex);
+      Running[B]--;
+    };
+    Scheduler.evaluate(NumConfigs, Fn, Weight);
+  };
+  // The batch of weight 2 outlasts the other one
+  thread Light(runBatch, 0, 10, 1);
+  this_thread::sleep_for(chrono::milliseconds(20));
+  thread Heavy(runBatch, 1, 40, 2);
+  this_thread::sleep_for(chrono::milliseconds(50));
+  Release.set_value();
+  Blocker.join();
+  Light.join();
+  Heavy.join();
+  CHECK(MaxRunning[0] == 1);
+  CHECK(MaxRunning[1] >= 2);
+}
+
+// Background batches only get workers no other batch has configurations for
+static void testSchedulerBackground() {
+  HMScheduler Scheduler(1);
+  promise<void> Release;
+  shared_future<void> Gate = Release.get_future().share();
+  thread Blocker([&] {
+    HMEvaluator::ObjectiveFn Fn = [&](size_t) { Gate.wait(); };
+    Scheduler.evaluate(1, Fn);
+  });
+  this_thread::sleep_for(chrono::milliseconds(50));
+
+  mutex Mutex;
+  string Order;
+  auto record = [&](char Batch) {
+    return HMEvaluator::ObjectiveFn([&, Batch](size_t) {
+      lock_guard<mutex> Lock(Mutex);
+      Order += Batch;
+    });
+  };
+  HMEvaluator::ObjectiveFn Speculative = record('s'), Requested = record('r');
+  thread Background([&] { Scheduler.evaluateBackground(2, Speculative); });
+  this_thread::sleep_for(chrono::milliseconds(20));
+  thread Foreground([&] { Scheduler.evaluate(2, Requested); });
+  this_thread::sleep_for(chrono::milliseconds(50));
+  Release.set_value();
+  Blocker.join();
+  Background.join();
+  Foreground.join();
+  CHECK(Order == "rrss");
+}
+
+// Reads from FD until Expected has arrived, for at most a second
+static bool readExpected(int FD, const string &Expected) {
+  string Received;
+  char Buffer[1 << 16];
+  auto Deadline = chrono::steady_clock::now() + chrono::seconds(1);
+  while (Received.size() < Expected.size()) {
+    auto Left = chrono::duration_cast<chrono::milliseconds>(
+        Deadline - chrono::steady_clock::now());
+    pollfd P = {FD, POLLIN, 0};
+    if (Left.count() <= 0 || poll(&P, 1, Left.count()) <= 0)
+      return false;
+    ssize_t N = read(FD, Buffer, sizeof(Buffer));
+    if (N <= 0)
+      return false;
+    Received.append(Buffer, N);
+  }
+  return Received == Expected;
+}
+
+// Held rows reach the reader at the deadline without a further flush, also
+// when they were appended while another thread was writing
+static void testReplyStreamDeadline() {
+  int Pipe[2];
+  CHECK(pipe(Pipe) == 0);
+  HMReplyStream Stream(chrono::milliseconds(20), 1024, HMLogOff);
+  Stream.start(Pipe[1], "Header\n");
+  CHECK(readExpected(Pipe[0], "Header\n"));
+
+  auto appendLine = [&](const string &Text) {
+    Stream.append([&](HMResponseWriter &Out) { Out.append(Text); });
+  };
+  appendLine("row 1\n");
+  Stream.flush();
+  CHECK(readExpected(Pipe[0], "row 1\n"));
+
+  // More than the pipe holds, so the flush blocks in its write
+  string Large(1 << 18, 'x');
+  appendLine("row 2\n");
+  Stream.flush();
+  appendLine(Large);
+  thread Writer([&] { Stream.flush(); });
+  this_thread::sleep_for(chrono::milliseconds(20));
+  appendLine("row 3\n");
+  // The deadline of row 3 passes during the write
+  this_thread::sleep_for(chrono::milliseconds(60));
+  CHECK(readExpected(Pipe[0], "row 2\n" + Large));
+  Writer.join();
+  CHECK(readExpected(Pipe[0], "row 3\n"));
+
+  Stream.finish();
+  close(Pipe[0]);
+  close(Pipe[1]);
+}
+
+// Configurations that hang, crash or throw fail alone, and the workers
+// replaced for them evaluate the next batch
+static void testProcessPoolFailures() {
+  // x = 0 evaluates, 1 hangs, 2 crashes and 3 throws
+  HMProcessPool Pool(2, 1, 1, 0, 0.2, [](const HMBatch &Config,
+                                          HMResults &Result) {
+    double X = Config.get(0, 0);
+    if (X == 1)
+      this_thread::sleep_for(chrono::seconds(10));
+    if (X == 2)
+      _exit(1);
+    if (X == 3)
+      throw runtime_error("test failure");
+    Result.objective(0)[0] = 10;
+    Result.feasibleAt(0) = 1;
+  });
+  size_t NumRows = 8;
+  HMBatch Batch;
+  Batch.resize(NumRows, 1);
+  vector<size_t> Configs(NumRows);
+  for (size_t i = 0; i < NumRows; i++) {
+    Batch.at(i, 0) = i % 4;
+    Configs[i] = i;
+  }
+  HMResults Results;
+  Results.reset(NumRows, 1, 0);
+  vector<uint8_t> Failed;
+  vector<int> NumCompleted(NumRows, 0);
+  Pool.evaluate(Batch, Configs, Results, Failed,
+                [&](size_t Row) { NumCompleted[Row]++; });
+  for (size_t i = 0; i < NumRows; i++) {
+    CHECK(NumCompleted[i] == 1);
+    CHECK(Failed[i] == (i % 4 != 0));
+    CHECK(Results.feasibleAt(i) == (i % 4 == 0));
+    if (i % 4 == 0)
+      CHECK(Results.objective(0)[i] == 10);
+  }
+  CHECK(Pool.getNumTimeouts() == 2);
+  CHECK(Pool.getNumCrashes() == 2);
+
+  for (size_t i = 0; i < NumRows; i++)
+    Batch.at(i, 0) = 0;
+  Results.reset(NumRows, 1, 0);
+  Pool.evaluate(Batch, Configs, Results, Failed);
+  for (size_t i = 0; i < NumRows; i++)
+    CHECK(!Failed[i] && Results.objective(0)[i] == 10);
+  CHECK(Pool.getNumTimeouts() == 2);
+  CHECK(Pool.getNumCrashes() == 2);
+}
+
+// A pool whose workers crash on every configuration reports an error
+// instead of replacing them forever
+static void testProcessPoolGivesUp() {
+  HMProcessPool Pool(2, 1, 1, 0, 0, [](const HMBatch &, HMResults &) {
+    _exit(1);
+  });
+  HMBatch Batch;
+  Batch.resize(20, 1);
+  HMResults Results;
+  Results.reset(20, 1, 0);
+  vector<size_t> Configs(20);
+  for (size_t i = 0; i < Configs.size(); i++)
+    Configs[i] = i;
+  vector<uint8_t> Failed;
+  bool GaveUp = false;
+  try {
+    Pool.evaluate(Batch, Configs, Results, Failed);
+  } catch (const HMError &) {
+    GaveUp = true;
+  }
+  CHECK(GaveUp);
+  CHECK(Pool.getNumCrashes() == 7);
+}
+
+// Output folder of the scripted runs, relative to the working directory as
+// HMScenario::OutputFoldername is
+static const string TestDir = "client_test_out";
+
+// Connection of the test playing HyperMapper to the client
+struct HMScriptedPeer {
+  int FD;
+  HMLineReader Reader;
+
+  explicit HMScriptedPeer(int _FD) : FD(_FD), Reader(_FD, 1 << 16) {}
+
+  void send(const string &Data) { writeAll(FD, Data); }
+  // Next line with its '\n', empty once the client is gone
+  string readLine() {
+    string_view Line;
+    return Reader.readLine(Line) ? string(Line) : string();
+  }
+  string readBytes(size_t Size) {
+    string_view Data;
+    return Reader.readBytes(Size, Data) ? string(Data) : string();
+  }
+};
+
+// Scenario of the scripted runs: an integer x in [0, 10] and a categorical
+// c in {a, b}, keyed x0 and x1 in requests, see scriptedObjective
+static HMScenario getScriptedScenario(const string &AppName) {
+  static HMInputParam X("x", ParamType::Integer);
+  static HMInputParam C("c", ParamType::Categorical);
+  X.setRange({0, 10});
+  C.setCategories({"a", "b"});
+  HMScenario Scenario;
+  Scenario.AppName = AppName;
+  Scenario.OutputFoldername = TestDir;
+  Scenario.Objectives = {"f1", "f2"};
+  Scenario.InParams = {&X, &C};
+  Scenario.NumCPUs = 1;
+  Scenario.ComputePareto = false;
+  Scenario.LogLevel = HMLogOff;
+  return Scenario;
+}
+
+// f1 = x and f2 = 2x, plus one for category b
+static void scriptedObjective(const HMConfig &Config, HMObjective &Obj) {
+  Obj[0] = Config.getInt(0);
+  Obj[1] = 2 * Config.getInt(0) + (Config.getCategory(1) == "b");
+  Obj.setFeasible(true);
+}
+
+// Runs Scenario with the HyperMapper side played by Script. Returns the
+// error the run failed with, empty if it succeeded.
+static string runScripted(HMScenario Scenario, const HMObjectiveFn &Objective,
+                          const function<void(HMScriptedPeer &)> &Script) {
+  string Path = "/tmp/hm_client_test_" + to_string(getpid()) + ".sock";
+  unlink(Path.c_str());
+  int Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un Address;
+  memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  strncpy(Address.sun_path, Path.c_str(), sizeof(Address.sun_path) - 1);
+  if (Listener < 0 ||
+      bind(Listener, reinterpret_cast<sockaddr *>(&Address),
+           sizeof(Address)) ||
+      listen(Listener, 1))
+    return string("Unable to listen on ") + Path + ": " + strerror(errno);
+
+  Scenario.Connect = "unix:" + Path;
+  Scenario.ConnectTimeout = 10;
+  string Error;
+  thread Client([&] {
+    try {
+      HyperMapperClient HMClient;
+      HMClient.run(Scenario, Objective);
+    } catch (const HMError &E) {
+      Error = E.what();
+    }
+  });
+  int FD = accept(Listener, nullptr, nullptr);
+  close(Listener);
+  unlink(Path.c_str());
+  if (FD >= 0) {
+    HMScriptedPeer HM(FD);
+    // Writes fail once the client has given up; its error is the one kept
+    try {
+      Script(HM);
+    } catch (const HMError &) {
+    }
+    close(FD);
+  }
+  Client.join();
+  if (!Error.empty())
+    cerr << Scenario.AppName << ": " << Error << endl;
+  return Error;
+}
+
+// Reads the file at Path
+static string readFile(const string &Path) {
+  ifstream In(Path);
+  stringstream Text;
+  Text << In.rdbuf();
+  return Text.str();
+}
+
+// FRequest batches are read from their csv file and answered in <file>.out
+static void testFileRequest() {
+  string Request = fs::absolute(TestDir + "/frequest.csv");
+  string Error = runScripted(
+      getScriptedScenario("frequest"), scriptedObjective,
+      [&](HMScriptedPeer &HM) {
+        ofstream(Request) << "x1,x0\nb,3\na,5\n";
+        HM.send("FRequest 2 " + Request + "\n");
+        CHECK(HM.readLine() == "Ready " + Request + ".out\n");
+        CHECK(readFile(Request + ".out") ==
+              "x1,x0,f1,f2,Valid\nb,3,3,7,1\na,5,5,10,1\n");
+        HM.send("End of HyperMapper\n");
+      });
+  CHECK(Error.empty());
+}
+
+// Lines and binary data mixed in one stream are read from the same buffer,
+// however the pipe splits them
+static void testLineReaderMixed() {
+  HMResponseWriter Message;
+  Message.append("BRequest 2\nx0\n");
+  Message.appendLE(uint64_t(2 * sizeof(double)));
+  Message.appendLE(1.5);
+  Message.appendLE(-2.0);
+  // Newline bytes of binary data do not end a line
+  Message.appendLE(uint64_t(0x0a0a0a0a0a0a0a0a));
+  Message.append("End of HyperMapper\n");
+  int Pipe[2];
+  CHECK(pipe(Pipe) == 0);
+  thread Writer([&] {
+    for (char C : Message.data())
+      if (write(Pipe[1], &C, 1) != 1)
+        break;
+    close(Pipe[1]);
+  });
+  // A small buffer is moved and grown while reading
+  HMLineReader Reader(Pipe[0], 4);
+  string_view Data;
+  CHECK(Reader.readLine(Data) && Data == "BRequest 2\n");
+  CHECK(Reader.readLine(Data) && Data == "x0\n");
+  CHECK(Reader.readBytes(sizeof(uint64_t), Data) &&
+        readLE64(Data, 0) == 2 * sizeof(double));
+  CHECK(Reader.readBytes(2 * sizeof(double), Data) &&
+        readLEDouble(Data, 0) == 1.5 &&
+        readLEDouble(Data, sizeof(double)) == -2.0);
+  CHECK(Reader.readBytes(sizeof(uint64_t), Data) &&
+        Data == string(sizeof(uint64_t), '\n'));
+  CHECK(Reader.readLine(Data) && Data == "End of HyperMapper\n");
+  CHECK(!Reader.readLine(Data));
+  CHECK(!Reader.readBytes(1, Data));
+  Writer.join();
+  close(Pipe[0]);
+}
+
+// The binary protocol is accepted when offered and a BRequest is answered
+// with one column per output, categories sent as their index
+static void testBinaryRequest() {
+  HMScenario Scenario = getScriptedScenario("brequest");
+  Scenario.BinaryProtocol = true;
+  string Error =
+      runScripted(Scenario, scriptedObjective, [](HMScriptedPeer &HM) {
+        HM.send("Protocol binary 1\n");
+        CHECK(HM.readLine() == "Protocol binary 1\n");
+        HMResponseWriter Request;
+        Request.append("BRequest 2\nx1,x0\n");
+        Request.appendLE(uint64_t(4 * sizeof(double)));
+        for (double Value : {1.0, 0.0, 3.0, 5.0})
+          Request.appendLE(Value);
+        HM.send(string(Request.data()));
+        CHECK(HM.readLine() == "BResponse 2\n");
+        CHECK(HM.readLine() == "f1,f2,Valid\n");
+        vector<double> Expected = {3, 5, 7, 10, 1, 1};
+        size_t Size = Expected.size() * sizeof(double);
+        string Reply = HM.readBytes(sizeof(uint64_t) + Size);
+        CHECK(Reply.size() == sizeof(uint64_t) + Size &&
+              readLE64(Reply, 0) == Size);
+        for (size_t i = 0; i < Expected.size() && Reply.size() > Size; i++)
+          CHECK(readLEDouble(Reply, (i + 1) * sizeof(double)) ==
+                Expected[i]);
+        HM.send("End of HyperMapper\n");
+      });
+  CHECK(Error.empty());
+}
+
+// A client without binary_protocol refuses the offer and keeps to text
+static void testBinaryOfferRefused() {
+  string Error = runScripted(
+      getScriptedScenario("refused"), scriptedObjective,
+      [](HMScriptedPeer &HM) {
+        HM.send("Protocol binary 1\n");
+        CHECK(HM.readLine() == "Protocol text\n");
+        HM.send("Request 1\nx0,x1\n4,b\n");
+        CHECK(HM.readLine() == "x0,x1,f1,f2,Valid\n");
+        CHECK(HM.readLine() == "4,b,4,9,1\n");
+        HM.send("End of HyperMapper\n");
+      });
+  CHECK(Error.empty());
+}
+
+// Cached evaluations are reloaded by the next run, a record cut short is
+// dropped and a log of another scenario is set aside
+static void testCacheReload() {
+  fs::create_directories(TestDir);
+  string Path = TestDir + "/cache.bin";
+  double Keys[3][2] = {{1, 2}, {3, 4}, {5, 6}};
+  double Outputs[3] = {10, 20, 30};
+  {
+    HMEvalCache Cache;
+    Cache.open(Path, 42, 2, 1, HMLogOff);
+    Cache.insert(Keys[0], &Outputs[0], true);
+    Cache.insert(Keys[1], &Outputs[1], false);
+    Cache.close();
+  }
+  // The tail of a run killed while appending
+  ofstream(Path, ios::app | ios::binary) << string(5, 'x');
+  {
+    HMEvalCache Cache;
+    Cache.open(Path, 42, 2, 1, HMLogOff);
+    CHECK(Cache.size() == 2);
+    const double *Found = Cache.find(Keys[0]);
+    CHECK(Found && Found[0] == 10 && Found[1] == 1);
+    Found = Cache.find(Keys[1]);
+    CHECK(Found && Found[0] == 20 && Found[1] == 0);
+    CHECK(!Cache.find(Keys[2]));
+    // Appended where the partial record was
+    Cache.insert(Keys[2], &Outputs[2], true);
+    Cache.close();
+  }
+  {
+    HMEvalCache Cache;
+    Cache.open(Path, 42, 2, 1, HMLogOff);
+    CHECK(Cache.size() == 3);
+    const double *Found = Cache.find(Keys[2]);
+    CHECK(Found && Found[0] == 30 && Found[1] == 1);
+  }
+  HMEvalCache Cache;
+  Cache.open(Path, 43, 2, 1, HMLogOff);
+  CHECK(Cache.size() == 0);
+  CHECK(fs::exists(Path + ".old"));
+}
+
+// The checkpoint keeps the committed rows for the next run and drops a row
+// cut short
+static void testCheckpointLog() {
+  fs::create_directories(TestDir);
+  string Path = TestDir + "/checkpoint.csv";
+  string Header = "x0,f1,Timestamp";
+  {
+    HMCheckpoint Checkpoint;
+    Checkpoint.open(Path, Header, HMLogOff);
+    Checkpoint.append("1,2,5", 5);
+    Checkpoint.append("3,4,9", 9);
+    Checkpoint.commit();
+    Checkpoint.close();
+  }
+  // The tail of a run killed while appending
+  ofstream(Path, ios::app) << "5,6";
+  {
+    HMCheckpoint Checkpoint;
+    Checkpoint.open(Path, Header, HMLogOff);
+    CHECK(Checkpoint.size() == 2);
+    CHECK(Checkpoint.getLastTimestamp() == 9);
+    Checkpoint.append("7,8,12", 12);
+    Checkpoint.commit();
+  }
+  CHECK(readFile(Path) == Header + "\n1,2,5\n3,4,9\n7,8,12\n");
+
+  HMCheckpoint Checkpoint;
+  Checkpoint.open(Path, "x0,f1,f2,Timestamp", HMLogOff);
+  CHECK(Checkpoint.size() == 0);
+  CHECK(fs::exists(Path + ".old"));
+}
+
+// Number of rows of the csv file at Path, without its header
+static size_t countRows(const string &Path) {
+  string Text = readFile(Path);
+  size_t NumLines = count(Text.begin(), Text.end(), '\n');
+  return NumLines > 0 ? NumLines - 1 : 0;
+}
+
+// A run with a checkpoint hands the rows of the previous run to
+// HyperMapper as resume data and adds its own to them
+static void testCheckpointResume() {
+  HMScenario Scenario = getScriptedScenario("resume");
+  Scenario.Checkpoint = true;
+  string ScenarioPath = TestDir + "/resume_scenario.json";
+  string CheckpointPath =
+      fs::absolute(TestDir + "/resume_checkpoint.csv").string();
+  auto runBatch = [&](bool Resumed, const string &Request) {
+    return runScripted(
+        Scenario, scriptedObjective, [&](HMScriptedPeer &HM) {
+          nlohmann::json Written;
+          ifstream(ScenarioPath) >> Written;
+          CHECK(Written.value("resume_optimization", false) == Resumed);
+          if (Resumed)
+            CHECK(Written.value("resume_optimization_data", "") ==
+                  CheckpointPath);
+          HM.send(Request);
+          // Header and rows of the reply
+          size_t NumLines = count(Request.begin(), Request.end(), '\n') - 1;
+          for (size_t i = 0; i < NumLines; i++)
+            CHECK(!HM.readLine().empty());
+          HM.send("End of HyperMapper\n");
+        });
+  };
+  CHECK(runBatch(false, "Request 2\nx0,x1\n3,b\n5,a\n").empty());
+  CHECK(countRows(CheckpointPath) == 2);
+  CHECK(runBatch(true, "Request 1\nx0,x1\n7,a\n").empty());
+  CHECK(countRows(CheckpointPath) == 3);
+}
+
+// Estimates are stopped once dominated by a configuration evaluated in
+// full even after the improvement left to them, and record their fidelity
+static void testEarlyStopDomination() {
+  // Two objectives and the fidelity in column 2
+  HMEarlyStop EarlyStop(2, 2, 0.1, 0.1);
+  HMResults Results;
+  Results.reset(3, 2, 1);
+  EarlyStop.reset(3);
+  auto setObjectives = [&](size_t Row, double F1, double F2) {
+    Results.objective(0)[Row] = F1;
+    Results.objective(1)[Row] = F2;
+    Results.feasibleAt(Row) = 1;
+  };
+  setObjectives(0, 1, 1);
+  CHECK(EarlyStop.report(Results, 0, 0.5));
+  EarlyStop.finish(Results, 0);
+  CHECK(Results.at(0, 2) == 1);
+
+  // Too early to tell, then dominated with 5% left to improve
+  setObjectives(1, 2, 2);
+  CHECK(EarlyStop.report(Results, 1, 0.05));
+  CHECK(!EarlyStop.report(Results, 1, 0.5));
+  EarlyStop.finish(Results, 1);
+  CHECK(EarlyStop.isStopped(1));
+  CHECK(Results.at(1, 2) == 0.5);
+
+  // Within the margin of the front in f1
+  setObjectives(2, 1.05, 3);
+  CHECK(EarlyStop.report(Results, 2, 0.5));
+  EarlyStop.finish(Results, 2);
+  CHECK(!EarlyStop.isStopped(2));
+  CHECK(Results.at(2, 2) == 1);
+  CHECK(EarlyStop.getNumStopped() == 1);
+  CHECK(EarlyStop.getSavedBudget() == 0.5);
+}
+
+// With early stopping the reply has a Fidelity column, 1 for complete
+// evaluations and the fidelity reached for stopped ones
+static void testEarlyStopFidelityColumn() {
+  HMScenario Scenario = getScriptedScenario("early_stop");
+  Scenario.EarlyStopping = true;
+  HMObjectiveFn Objective = [](const HMConfig &Config, HMObjective &Obj) {
+    scriptedObjective(Config, Obj);
+    Obj.reportInterim(0.5);
+  };
+  string Error = runScripted(Scenario, Objective, [](HMScriptedPeer &HM) {
+    HM.send("Request 2\nx0,x1\n1,a\n6,a\n");
+    CHECK(HM.readLine() == "x0,x1,f1,f2,Valid,Fidelity\n");
+    CHECK(HM.readLine() == "1,a,1,2,1,1\n");
+    CHECK(HM.readLine() == "6,a,6,12,1,0.5\n");
+    HM.send("End of HyperMapper\n");
+  });
+  CHECK(Error.empty());
+}
+
+int main() {
+  // Runs connect to the test and log nothing whatever the environment says
+  unsetenv("HM_CONNECT");
+  unsetenv("HM_LOG_LEVEL");
+  fs::remove_all(TestDir);
+  testFormatValue();
+  testNumericCategories();
+  testAgentsServeRenamedStudies();
+  testSchedulerFairShare();
+  testSchedulerBackground();
+  testReplyStreamDeadline();
+  testProcessPoolFailures();
+  testProcessPoolGivesUp();
+  testFileRequest();
+  testLineReaderMixed();
+  testBinaryRequest();
+  testBinaryOfferRefused();
+  testCacheReload();
+  testCheckpointLog();
+  testCheckpointResume();
+  testEarlyStopDomination();
+  testEarlyStopFidelityColumn();
+  fs::remove_all(TestDir);
+  if (NumFailures)
+    cerr << NumFailures << " checks failed" << endl;
+  else
+    cout << "All checks passed" << endl;
+  return NumFailures;
+}
@@ -6,6 +6,8 @@ import compute_pareto
 import plot_dse
 import json
 import os
+import io
+import hypermapper_session
 from utility_functions import *
 import json
 from jsonschema import Draft4Validator, validators, exceptions
@@ -72,18 +74,47 @@ def optimize(parameters_file, black_box_function=None):
     sys.stdout.write_protocol("End of HyperMapper\n")
 
 
+def listen_for_client(address):
+    """
+    Wait for one client on address and redirect stdin and stdout to the connection so that the client-server
+    protocol runs over it.
+    :param address: the address to listen on, see open_listener.
+    """
+    listener = open_listener(address)
+    print("Waiting for a client on %s" % address, file=sys.stderr)
+    connection = accept_client(listener)
+    listener.close()
+    # Text streams over the connection that keep the .buffer used by the binary protocol
+    sys.stdin = io.TextIOWrapper(connection.makefile("rb"), encoding="utf-8")
+    sys.stdout = io.TextIOWrapper(connection.makefile("wb"), encoding="utf-8", write_through=True)
+    connection.close()
+
+
 if __name__ == "__main__":
-    if len(sys.argv) == 2:
+    listen_address = None
+    if len(sys.argv) == 3 and sys.argv[1] == "--session":
+        hypermapper_session.serve(sys.argv[2], optimize)
+        exit(0)
+    if len(sys.argv) == 4 and sys.argv[2] == "--listen":
+        listen_address = sys.argv[3]
+    if len(sys.argv) == 2 or listen_address:
         parameters_file = sys.argv[1]
     else :
-        print("Error: only one argument needed, the parameters json file.")
+        print("Error: only one argument needed, the parameters json file, optionally followed by --listen ADDRESS.")
+        parameters_file = None
 
-    if parameters_file == "--help" or len(sys.argv) != 2:
+    if parameters_file is None or parameters_file == "--help":
         print("################################################")
         print("### Example: ")
         print("### cd hypermapper")
         print("### python3 scripts/hypermapper.py example_scenarios/spatial/BlackScholes_scenario.json")
+        print("### Client-server mode with a client connecting on a socket:")
+        print("### python3 scripts/hypermapper.py scenario.json --listen unix:/tmp/hypermapper.sock")
+        print("### Warm session running the studies of any number of clients:")
+        print("### python3 scripts/hypermapper.py --session unix:/tmp/hypermapper.sock")
         print("################################################")
         exit(1)
 
+    if listen_address:
+        listen_for_client(listen_address)
     optimize(parameters_file)
@@ -0,0 +1,258 @@
+import io
+import os
+import selectors
+import signal
+import sys
+import traceback
+from utility_functions import open_listener, accept_client
+
+# Warm HyperMapper session: the modules are imported once by this process and every study runs in a process forked
+# from it, so a study does not pay the interpreter and library start up.
+#
+# Clients connect on the session address and send "HMSession 1", answered by "Ready". Every message after that is a
+# line naming a study, optionally followed by a payload:
+#   client: Open <id> <scenario file>, Data <id> <size>, Close <id>, Kill <id>
+#   server: Data <id> <size>, Exit <id> <status>
+# Data carries the usual client-server protocol stream of the study, Close ends its input and Kill terminates it.
+
+read_size = 256 << 10
+
+
+class Study:
+    """
+    One study of a client, running in a forked process whose stdin and stdout are pipes of the session.
+    """
+    def __init__(self, study_id, pid, to_study, from_study):
+        self.id = study_id
+        self.pid = pid
+        self.to_study = to_study
+        self.from_study = from_study
+        self.pending = bytearray()
+        self.closing = False
+
+
+class Client:
+    """
+    A connection to a client and the studies it opened.
+    """
+    def __init__(self, connection):
+        self.connection = connection
+        self.incoming = bytearray()
+        self.outgoing = bytearray()
+        self.studies = {}
+        self.ready = False
+
+
+def run_study(parameters_file, to_study, from_study, optimize):
+    """
+    Body of a forked study process: run optimize with stdin and stdout redirected to the session pipes.
+    """
+    status = 1
+    try:
+        os.dup2(to_study, 0)
+        os.dup2(from_study, 1)
+        os.closerange(3, os.sysconf("SC_OPEN_MAX"))
+        sys.stdin = io.TextIOWrapper(os.fdopen(0, "rb"), encoding="utf-8")
+        sys.stdout = io.TextIOWrapper(os.fdopen(1, "wb"), encoding="utf-8", write_through=True)
+        signal.signal(signal.SIGTERM, signal.SIG_DFL)
+        optimize(parameters_file)
+        sys.stdout.flush()
+        status = 0
+    except SystemExit as e:
+        status = e.code if isinstance(e.code, int) else 1
+    except BaseException:
+        traceback.print_exc()
+    os._exit(status)
+
+
+class Session:
+    def __init__(self, address, optimize):
+        self.optimize = optimize
+        self.selector = selectors.DefaultSelector()
+        self.listener = open_listener(address)
+        self.listener.setblocking(False)
+        self.selector.register(self.listener, selectors.EVENT_READ, None)
+
+    def serve(self):
+        while True:
+            for key, events in self.selector.select():
+                # Skip descriptors closed by an earlier event of the same round
+                current = self.selector.get_map().get(key.fd)
+                if current is None or current.data is not key.data:
+                    continue
+                if key.data is None:
+                    self.accept()
+                elif isinstance(key.data, Client):
+                    self.serve_client(key.data, events)
+                else:
+                    self.serve_study(*key.data, events)
+
+    def accept(self):
+        connection = accept_client(self.listener)
+        connection.setblocking(False)
+        client = Client(connection)
+        self.selector.register(connection, selectors.EVENT_READ, client)
+
+    def update_client(self, client):
+        events = selectors.EVENT_READ | (selectors.EVENT_WRITE if client.outgoing else 0)
+        self.selector.modify(client.connection, events, client)
+
+    def send(self, client, message, payload=b""):
+        client.outgoing += message.encode() + b"\n" + payload
+        self.update_client(client)
+
+    def serve_client(self, client, events):
+        if events & selectors.EVENT_WRITE:
+            try:
+                sent = client.connection.send(client.outgoing)
+                del client.outgoing[:sent]
+            except BlockingIOError:
+                pass
+            except OSError:
+                self.drop_client(client)
+                return
+            self.update_client(client)
+        if events & selectors.EVENT_READ:
+            try:
+                data = client.connection.recv(read_size)
+            except BlockingIOError:
+                return
+            except OSError:
+                data = b""
+            if not data:
+                self.drop_client(client)
+                return
+            client.incoming += data
+            self.parse_messages(client)
+
+    def parse_messages(self, client):
+        while True:
+            newline = client.incoming.find(b"\n")
+            if newline < 0:
+                return
+            header = client.incoming[:newline].decode()
+            if not client.ready:
+                del client.incoming[:newline + 1]
+                if header != "HMSession 1":
+                    client.connection.sendall(b"Error unsupported session protocol\n")
+                    self.drop_client(client)
+                    return
+                client.ready = True
+                self.send(client, "Ready")
+                continue
+            fields = header.split(" ", 2)
+            kind, study_id = fields[0], int(fields[1])
+            if kind == "Data":
+                size = int(fields[2])
+                if len(client.incoming) < newline + 1 + size:
+                    return
+                study = client.studies.get(study_id)
+                if study and study.to_study is not None:
+                    study.pending += client.incoming[newline + 1:newline + 1 + size]
+                    self.update_study(client, study)
+                del client.incoming[:newline + 1 + size]
+                continue
+            del client.incoming[:newline + 1]
+            if kind == "Open":
+                self.open_study(client, study_id, fields[2])
+            elif kind in ("Close", "Kill") and study_id in client.studies:
+                study = client.studies[study_id]
+                if kind == "Kill":
+                    os.kill(study.pid, signal.SIGTERM)
+                    study.pending.clear()
+                study.closing = True
+                self.update_study(client, study)
+
+    def open_study(self, client, study_id, parameters_file):
+        to_study_read, to_study_write = os.pipe()
+        from_study_read, from_study_write = os.pipe()
+        sys.stdout.flush()
+        sys.stderr.flush()
+        pid = os.fork()
+        if pid == 0:
+            run_study(parameters_file, to_study_read, from_study_write, self.optimize)
+        os.close(to_study_read)
+        os.close(from_study_write)
+        os.set_blocking(to_study_write, False)
+        os.set_blocking(from_study_read, False)
+        study = Study(study_id, pid, to_study_write, from_study_read)
+        client.studies[study_id] = study
+        self.selector.register(from_study_read, selectors.EVENT_READ, (client, study, from_study_read))
+        print("Study %d of %s started in process %d" % (study_id, parameters_file, pid), file=sys.stderr)
+
+    def update_study(self, client, study):
+        """
+        Write what is pending to the study's stdin and close it once the client is done with it.
+        """
+        if study.to_study is None:
+            return
+        if study.pending:
+            try:
+                written = os.write(study.to_study, study.pending)
+                del study.pending[:written]
+            except BlockingIOError:
+                pass
+            except OSError:
+                study.pending.clear()
+        registered = study.to_study in self.selector.get_map()
+        if study.closing and not study.pending:
+            if registered:
+                self.selector.unregister(study.to_study)
+            os.close(study.to_study)
+            study.to_study = None
+        elif study.pending and not registered:
+            self.selector.register(study.to_study, selectors.EVENT_WRITE, (client, study, study.to_study))
+        elif not study.pending and registered:
+            self.selector.unregister(study.to_study)
+
+    def serve_study(self, client, study, fd, events):
+        if fd == study.to_study:
+            self.update_study(client, study)
+            return
+        try:
+            data = os.read(study.from_study, read_size)
+        except BlockingIOError:
+            return
+        if data:
+            self.send(client, "Data %d %d" % (study.id, len(data)), data)
+            return
+        self.finish_study(client, study)
+        self.send(client, "Exit %d %d" % (study.id, self.wait_study(study)))
+
+    def finish_study(self, client, study):
+        self.selector.unregister(study.from_study)
+        os.close(study.from_study)
+        if study.to_study is not None:
+            if study.to_study in self.selector.get_map():
+                self.selector.unregister(study.to_study)
+            os.close(study.to_study)
+            study.to_study = None
+        del client.studies[study.id]
+
+    def wait_study(self, study):
+        _, status = os.waitpid(study.pid, 0)
+        if os.WIFEXITED(status):
+            return os.WEXITSTATUS(status)
+        return 128 + os.WTERMSIG(status)
+
+    def drop_client(self, client):
+        """
+        Terminate the studies of a client that disconnected.
+        """
+        for study in list(client.studies.values()):
+            os.kill(study.pid, signal.SIGTERM)
+            self.finish_study(client, study)
+            self.wait_study(study)
+        self.selector.unregister(client.connection)
+        client.connection.close()
+
+
+def serve(address, optimize):
+    """
+    Run a HyperMapper session on address until interrupted.
+    :param address: unix:<path> or <host>:<port>.
+    :param optimize: the function running one study given its scenario file.
+    """
+    session = Session(address, optimize)
+    print("HyperMapper session listening on %s" % address, file=sys.stderr)
+    session.serve()
@@ -5,6 +5,7 @@ import datetime
 import time
 from collections import OrderedDict
 import csv
+import struct
 import ply.lex as lex
 import ply.yacc as yacc
 from utility_functions import *
@@ -583,6 +584,9 @@ class Space :
         self.parameters_python_type = OrderedDict()
         self.optimization_metrics = config["optimization_objectives"]
         self.timestamp_name = config["timestamp"]
+        self.file_protocol_batch_size = config.get("hypermapper_mode", {}).get("file_protocol_batch_size", 0)
+        self.binary_protocol = config.get("hypermapper_mode", {}).get("binary_protocol", False)
+        self.binary_protocol_accepted = None # Negotiated with the interacting system on the first request
         self.enable_feasible_predictor = ("feasible_output" in config) and (config["feasible_output"]["enable_feasible_predictor"] is True)
         if self.enable_feasible_predictor:
             feasible_output = config["feasible_output"]
@@ -1690,7 +1694,13 @@ class Space :
                 pass
 
         print("Communication protocol: sending message...")
-        read_write_on_a_file = False # This is the default case where we want communication via file instead of stdin/out
+        if self.binary_protocol and self.binary_protocol_accepted is None:
+            self.binary_protocol_accepted = self.negotiate_binary_protocol()
+        if self.binary_protocol_accepted:
+            return self.run_configurations_client_server_binary(configurations)
+
+        # The default case is communication via stdin/out, large batches can be exchanged via file instead
+        read_write_on_a_file = (self.file_protocol_batch_size > 0) and (len(configurations) >= self.file_protocol_batch_size)
         if read_write_on_a_file :
             file_to_send_to_interacting_system = deal_with_relative_and_absolute_path(run_directory, "interactive_protocol_file.csv")
             # Write to standard output to communicate with the interacting system,
@@ -1718,6 +1728,8 @@ class Space :
                     print("Error: expecting '%s' and received '%s'. Exit." %(ack_return_message, line))
                     exit(1)
             new_data_array, fast_addressing_of_data_array = self.load_data_file(file_to_receive_from_interactive_system)
+            if self.get_timestamp_parameter()[0] not in new_data_array:
+                new_data_array[self.get_timestamp_parameter()[0]] = [self.current_milli_time()]*len(configurations)
         else:
             # Write to stdout
             sys.stdout.write_protocol("Request %d\n" %len(configurations)) # From the Hypermapper/interacting system protocol
@@ -1775,6 +1787,88 @@ class Space :
             print("The size of the new set of samples in the run configurations method is %d" %len(next(iter(new_data_array.values()))))
         return new_data_array
 
+    def negotiate_binary_protocol(self):
+        """
+        Offer the binary protocol to the interacting system. This is only done when binary_protocol is enabled in the json,
+        so interacting systems that only know the text protocol never receive the offer.
+        :return: True if the interacting system accepted the binary protocol.
+        """
+        sys.stdout.write_protocol("Protocol binary 1\n")
+        line = sys.stdin.buffer.readline().decode()
+        sys.stdout.write(line)
+        if line == "Protocol binary 1\n":
+            return True
+        if line != "Protocol text\n":
+            print("Error: expecting a reply to the protocol offer and received '%s'. Exit." % line)
+            exit(1)
+        return False
+
+    def run_configurations_client_server_binary(self, configurations):
+        """
+        Run a set of configurations in client-server mode using the binary protocol.
+        HyperMapper sends "BRequest N", a line with the input parameter names, the payload size as a little-endian uint64
+        and then, for each parameter in header order, a column of N little-endian float64 values. Categorical parameters
+        are sent as the index of their value.
+        The interacting system answers "BResponse N", a line with the output names (optimization metrics and feasible flag),
+        the payload size and one column of N float64 values per output. A non-zero feasible value means feasible.
+        :param configurations: a list of configurations (dict).
+        :return: the dictionary with the evaluated configurations.
+        """
+        new_data_array = defaultdict(list)
+        input_parameters = self.get_input_parameters()
+        number_of_configurations = len(configurations)
+
+        columns = [np.asarray([configuration[parameter] for configuration in configurations], dtype='<f8') for parameter in input_parameters]
+        payload = b"".join(column.tobytes() for column in columns)
+        message = ("BRequest %d\n%s\n" % (number_of_configurations, ",".join(input_parameters))).encode()
+        sys.stdout.write_protocol_binary(message + struct.pack('<Q', len(payload)) + payload)
+
+        print("Communication protocol: receiving message....")
+        line = sys.stdin.buffer.readline().decode()
+        sys.stdout.write(line)
+        if line != "BResponse %d\n" % number_of_configurations:
+            print("Error: expecting 'BResponse %d' and received '%s'. Exit." % (number_of_configurations, line))
+            exit(1)
+        line = sys.stdin.buffer.readline().decode()
+        sys.stdout.write(line)
+        output_header = [x.strip() for x in line.split(',')]
+        payload_size = struct.unpack('<Q', self.read_exactly_from_stdin(8))[0]
+        if payload_size != 8 * len(output_header) * number_of_configurations:
+            print("Error: unexpected binary payload size %d. Exit." % payload_size)
+            exit(1)
+        output_columns = np.frombuffer(self.read_exactly_from_stdin(payload_size), dtype='<f8').reshape(len(output_header), number_of_configurations)
+
+        for parameter in input_parameters:
+            new_data_array[parameter] = [configuration[parameter] for configuration in configurations]
+        for output in self.get_output_parameters():
+            if output not in output_header:
+                print("Key Error while getting the binary configurations results.")
+                print("The key HyperMapper was looking for is: %s" % str(output))
+                print("The headers received are: %s" % str(output_header))
+                exit()
+            column = output_columns[output_header.index(output)]
+            if output == self.feasible_output_name:
+                new_data_array[output] = [bool(value != 0) for value in column]
+            else:
+                new_data_array[output] = [float(value) for value in column]
+        new_data_array[self.get_timestamp_parameter()[0]] = [self.current_milli_time()]*number_of_configurations
+        return new_data_array
+
+    def read_exactly_from_stdin(self, size):
+        """
+        Read exactly size bytes from the binary stdin.
+        :param size: number of bytes to read.
+        :return: the bytes read.
+        """
+        data = b""
+        while len(data) < size:
+            chunk = sys.stdin.buffer.read(size - len(data))
+            if not chunk:
+                print("Error: the interacting system closed the connection. Exit.")
+                exit(1)
+            data += chunk
+        return data
+
     def run_configurations_from_data_array(self, all_data_array, all_fast_addressing_of_data_array, beginning_of_time,
                                            configurations, doSleep=False):
         """
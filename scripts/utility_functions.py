@@ -1,4 +1,5 @@
 import os
+import socket
 import sys
 import multiprocessing as mp
 import numpy as np
@@ -80,6 +81,13 @@ class Logger():
         self.log.write(message)
         self.flush_protocol()
 
+    def write_protocol_binary(self, data):
+        self.terminal.flush()
+        self.terminal.buffer.write(data)
+        self.terminal.buffer.flush()
+        self.log.write("Binary protocol message of %d bytes\n" % len(data))
+        self.log.flush()
+
     def flush(self):
         if not self.log_only_on_file:
             self.terminal.flush()
@@ -516,4 +524,40 @@ def sample_weight_flat(optimization_metrics, evaluations_per_optimization_iterat
             objective_weights[objective] = sampled_weights[run_idx][idx]
         weight_list.append(objective_weights)
 
-    return weight_list
\ No newline at end of file
+    return weight_list
+
+
+socket_buffer_size = 4 << 20
+
+
+def open_listener(address):
+    """
+    Listen on address, either unix:<path> for a Unix domain socket or <host>:<port> for TCP.
+    :param address: the address to listen on.
+    :return: the listening socket.
+    """
+    if address.startswith("unix:"):
+        path = address[len("unix:"):]
+        if os.path.exists(path):
+            os.remove(path)
+        listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        listener.bind(path)
+    else:
+        host, _, port = address.rpartition(":")
+        listener = socket.create_server((host, int(port)), family=socket.AF_INET6 if ":" in host else socket.AF_INET)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, socket_buffer_size)
+    listener.listen()
+    return listener
+
+
+def accept_client(listener):
+    """
+    Accept a client connection with large buffers and, for TCP, without Nagle's algorithm.
+    :param listener: the listening socket.
+    :return: the connection.
+    """
+    connection, _ = listener.accept()
+    if connection.family != socket.AF_UNIX:
+        connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    connection.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, socket_buffer_size)
+    return connection
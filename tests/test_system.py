@@ -11,7 +11,13 @@ import compute_pareto
 import plot_dse
 import hypermapper
 from plot_hvi import HVI_from_files
+import csv
+import json
 import os
+import socket
+import struct
+import tempfile
+import time
 from os.path import isfile, join
 from subprocess import Popen, PIPE
 from utility_functions import *
@@ -62,7 +68,282 @@ def test_black_scholes():
     hvi = HVI_from_files(exhaustive_pareto_file, parameters_file)
     assert hvi < 80000
 
+def write_client_server_scenario(run_directory, hypermapper_mode):
+    """
+    Write a client-server scenario on the Chakong and Haimes function that is quick to run.
+    :param run_directory: the directory of the scenario and of the files of the run.
+    :param hypermapper_mode: the settings added to the client-server mode.
+    :return: the path of the scenario.
+    """
+    hypermapper_mode = dict(hypermapper_mode, mode="client-server")
+    scenario = {
+        "application_name": "client_server_test",
+        "optimization_objectives": ["f1_value", "f2_value"],
+        "hypermapper_mode": hypermapper_mode,
+        "run_directory": run_directory,
+        "design_of_experiment": {"doe_type": "random sampling", "number_of_samples": 4},
+        "optimization_iterations": 1,
+        "input_parameters": {
+            "x1": {"parameter_type": "real", "values": [-20, 20]},
+            "x2": {"parameter_type": "real", "values": [-20, 20]}
+        }
+    }
+    parameters_file = join(run_directory, "client_server_test_scenario.json")
+    with open(parameters_file, "w") as f:
+        json.dump(scenario, f, indent=4)
+    return parameters_file
+
+def chakong_haimes_row(x1, x2):
+    """
+    Evaluate the Chakong and Haimes function.
+    :return: the csv row of the reply with the inputs and both objectives.
+    """
+    f1_value = 2 + (x1 - 2)*(x1 - 2) + (x2 - 1)*(x2 - 1)
+    f2_value = 9*x1 - (x2 - 1)*(x2 - 1)
+    return [x1, x2, f1_value, f2_value]
+
+def serve_client_server(to_hypermapper, from_hypermapper, accept_binary=False):
+    """
+    Play the interacting system of the client-server protocol until HyperMapper ends.
+    :param to_hypermapper: the binary stream HyperMapper reads.
+    :param from_hypermapper: the binary stream HyperMapper writes.
+    :param accept_binary: whether to accept the offer of the binary protocol.
+    :return: the kind of every message received, e.g. "Request".
+    """
+    messages = []
+    while True:
+        line = from_hypermapper.readline().decode()
+        assert line, "HyperMapper exited without ending the protocol"
+        words = line.split()
+        messages.append(words[0])
+        if line == "End of HyperMapper\n":
+            return messages
+        if words[0] == "Request":
+            header = from_hypermapper.readline().decode().strip().split(",")
+            reply = "x1,x2,f1_value,f2_value\n"
+            for _ in range(int(words[1])):
+                values = dict(zip(header, map(float, from_hypermapper.readline().decode().split(","))))
+                reply += ",".join(map(str, chakong_haimes_row(values["x1"], values["x2"]))) + "\n"
+            to_hypermapper.write(reply.encode())
+        elif words[0] == "FRequest":
+            with open(words[2], "r") as f:
+                rows = list(csv.DictReader(f))
+            assert len(rows) == int(words[1])
+            with open(words[2] + ".out", "w") as f:
+                w = csv.writer(f)
+                w.writerow(["x1", "x2", "f1_value", "f2_value"])
+                for row in rows:
+                    w.writerow(chakong_haimes_row(float(row["x1"]), float(row["x2"])))
+            to_hypermapper.write(("Ready %s.out\n" % words[2]).encode())
+        elif line == "Protocol binary 1\n":
+            to_hypermapper.write(b"Protocol binary 1\n" if accept_binary else b"Protocol text\n")
+        elif words[0] == "BRequest":
+            assert accept_binary
+            number_of_configurations = int(words[1])
+            header = from_hypermapper.readline().decode().strip().split(",")
+            payload_size = struct.unpack("<Q", from_hypermapper.read(8))[0]
+            assert payload_size == 8 * len(header) * number_of_configurations
+            values = struct.unpack("<%dd" % (payload_size // 8), from_hypermapper.read(payload_size))
+            columns = dict(zip(header, [values[i:i + number_of_configurations] for i in range(0, len(values), number_of_configurations)]))
+            rows = [chakong_haimes_row(x1, x2) for x1, x2 in zip(columns["x1"], columns["x2"])]
+            # Objective columns only, the inputs are not echoed
+            reply = [row[column] for column in (2, 3) for row in rows]
+            to_hypermapper.write(("BResponse %d\nf1_value,f2_value\n" % number_of_configurations).encode())
+            to_hypermapper.write(struct.pack("<Q%dd" % len(reply), 8 * len(reply), *reply))
+        else:
+            assert False, "Unexpected message: %s" % line
+        to_hypermapper.flush()
+
+def run_client_server(parameters_file, accept_binary=False):
+    """
+    Run HyperMapper in client-server mode on stdin and stdout with serve_client_server on the other side.
+    :return: the kind of every message received.
+    """
+    cmd = ["python", "scripts/hypermapper.py", parameters_file]
+    p = Popen(cmd, stdin=PIPE, stdout=PIPE)
+    messages = serve_client_server(p.stdin, p.stdout, accept_binary)
+    assert p.wait() == 0
+    return messages
+
+def count_samples(run_directory):
+    """
+    :return: the number of samples in the output data file of a run.
+    """
+    with open(join(run_directory, "output_samples.csv"), "r") as f:
+        return len(list(csv.DictReader(f)))
+
+def connect_when_listening(path):
+    """
+    Connect to the Unix domain socket at path once HyperMapper listens on it.
+    :param path: the path of the socket.
+    :return: the connection.
+    """
+    for _ in range(600):
+        connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            connection.connect(path)
+            return connection
+        except (FileNotFoundError, ConnectionRefusedError):
+            connection.close()
+            time.sleep(0.1)
+    assert False, "HyperMapper is not listening on %s" % path
+
+class SessionStudyStream:
+    """
+    The client-server stream of one study of a HyperMapper session, carried by the Data messages of the session.
+    Reads and writes like the binary streams serve_client_server takes. reader and writer are the binary streams of
+    the session connection, shared by the studies of the client that run one after the other.
+    """
+    def __init__(self, reader, writer, study_id):
+        self.reader = reader
+        self.writer = writer
+        self.study_id = study_id
+        self.received = bytearray()
+        self.pending = bytearray()
+        self.exit_status = None
+
+    def send(self, message):
+        self.writer.write(message.encode())
+        self.writer.flush()
+
+    def receive(self):
+        """
+        Receive the next message of the study: its data or its exit status.
+        """
+        kind, study_id, value = self.reader.readline().decode().split()
+        assert int(study_id) == self.study_id
+        if kind == "Data":
+            self.received += self.reader.read(int(value))
+        else:
+            assert kind == "Exit"
+            self.exit_status = int(value)
+
+    def readline(self):
+        while b"\n" not in self.received and self.exit_status is None:
+            self.receive()
+        end = self.received.find(b"\n") + 1 or len(self.received)
+        line = bytes(self.received[:end])
+        del self.received[:end]
+        return line
+
+    def read(self, size):
+        while len(self.received) < size and self.exit_status is None:
+            self.receive()
+        data = bytes(self.received[:size])
+        del self.received[:size]
+        return data
+
+    def write(self, data):
+        self.pending += data
+
+    def flush(self):
+        self.send("Data %d %d\n" % (self.study_id, len(self.pending)))
+        self.writer.write(self.pending)
+        self.writer.flush()
+        self.pending.clear()
+
+    def wait(self):
+        """
+        :return: the exit status of the study.
+        """
+        while self.exit_status is None:
+            self.receive()
+        return self.exit_status
+
+def test_file_protocol():
+    """
+    This test runs the client-server mode with batches of two configurations or more exchanged through csv files.
+    The goal is to check that the design of experiment goes through FRequest and the smaller batches stay on stdin.
+    """
+    run_directory = tempfile.mkdtemp()
+    parameters_file = write_client_server_scenario(run_directory, {"file_protocol_batch_size": 2})
+    messages = run_client_server(parameters_file)
+    assert messages[0] == "FRequest"
+    assert "Request" in messages
+    assert count_samples(run_directory) >= 5
+
+def test_binary_protocol():
+    """
+    This test runs the client-server mode with the binary protocol accepted.
+    The goal is to check the BRequest/BResponse framing read with sys.stdin.buffer after the offer.
+    """
+    run_directory = tempfile.mkdtemp()
+    parameters_file = write_client_server_scenario(run_directory, {"binary_protocol": True})
+    messages = run_client_server(parameters_file, accept_binary=True)
+    assert messages[0] == "Protocol"
+    assert "BRequest" in messages
+    assert "Request" not in messages
+    assert count_samples(run_directory) >= 5
+
+def test_binary_protocol_refused():
+    """
+    This test offers the binary protocol to an interacting system that refuses it.
+    The goal is to check that the text protocol on sys.stdin still works after the reply was read from sys.stdin.buffer.
+    """
+    run_directory = tempfile.mkdtemp()
+    parameters_file = write_client_server_scenario(run_directory, {"binary_protocol": True})
+    messages = run_client_server(parameters_file)
+    assert messages[0] == "Protocol"
+    assert messages.count("Protocol") == 1
+    assert "Request" in messages
+    assert count_samples(run_directory) >= 5
+
+def test_listen():
+    """
+    This test runs the client-server mode with the interacting system connecting on a Unix domain socket.
+    The goal is to check that --listen carries the whole protocol, binary messages included, over the connection.
+    """
+    run_directory = tempfile.mkdtemp()
+    parameters_file = write_client_server_scenario(run_directory, {"binary_protocol": True})
+    address = join(run_directory, "hypermapper.sock")
+    cmd = ["python", "scripts/hypermapper.py", parameters_file, "--listen", "unix:" + address]
+    p = Popen(cmd)
+    connection = connect_when_listening(address)
+    messages = serve_client_server(connection.makefile("wb"), connection.makefile("rb"), accept_binary=True)
+    connection.close()
+    assert p.wait() == 0
+    assert "BRequest" in messages
+    assert count_samples(run_directory) >= 5
+
+def test_session():
+    """
+    This test runs studies in a warm HyperMapper session started with --session.
+    The goal is to check the session protocol: a study runs to completion over its Data messages, and a study that is
+    killed exits with the status of SIGTERM.
+    """
+    run_directory = tempfile.mkdtemp()
+    parameters_file = write_client_server_scenario(run_directory, {})
+    address = join(run_directory, "session.sock")
+    p = Popen(["python", "scripts/hypermapper.py", "--session", "unix:" + address])
+    try:
+        connection = connect_when_listening(address)
+        reader, writer = connection.makefile("rb"), connection.makefile("wb")
+        writer.write(b"HMSession 1\n")
+        writer.flush()
+        assert reader.readline() == b"Ready\n"
+        study = SessionStudyStream(reader, writer, 1)
+        study.send("Open 1 %s\n" % parameters_file)
+        messages = serve_client_server(study, study)
+        assert messages[-1] == "End"
+        study.send("Close 1\n")
+        assert study.wait() == 0
+        assert count_samples(run_directory) >= 5
+
+        killed = SessionStudyStream(reader, writer, 2)
+        killed.send("Open 2 %s\n" % parameters_file)
+        killed.send("Kill 2\n")
+        assert killed.wait() == 128 + 15
+        connection.close()
+    finally:
+        p.terminate()
+        p.wait()
+
 if __name__ == '__main__':
     test_quick_start()
     test_ordinal_branin()
     test_black_scholes()
+    test_file_protocol()
+    test_binary_protocol()
+    test_binary_protocol_refused()
+    test_listen()
+    test_session()